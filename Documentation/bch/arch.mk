@@ -8,8 +8,12 @@ $(ARCH)_XSHELL	:= $(XSHELL)
 $(ARCH)_XRUN	:= $(XRUN)
 
 XPROG	:= $(ARCH)_tu
-BINS	:= tool gf mem unaligned correct poly4
+BINS	:= tool gf mem unaligned correct poly4 snapshot init engine stats mt
+BINS	+= baseline micro prim bitorder correct_m20
 BINS	+= bench_dyn bench_m13t4 bench_m13t8 bench_m13t4c bench_m13t8c
+BINS	+= bench_m13t4tab bench_m13t8tab bench_multi bench_stats bench_m20
+XSPECS	:= $(patsubst %,$(XPROG)_spec_%.o,$(SPECS))
+XSPECS	+= $(patsubst %,$(XPROG)_isa_%.o,$(ISAS))
 SCRIPTS := bench.sh short.sh medium.sh long.sh
 XPROGS	:= $(addprefix $(XPROG)_,$(BINS))
 XSCRIPTS:= $(addprefix $(XPROG)_,$(SCRIPTS))
@@ -18,7 +22,42 @@ PROGS	+= $(XPROGS) $(XSCRIPTS)
 
 $(XPROG)_bench_%: arch := $(ARCH)
 $(XPROG)_bench_%: tu_bench.c $(SRC) $(HEADER)
-	$($(arch)_XCC) $($(arch)_XCFLAGS) $(SRC) $< -lrt -lm -o $@
+	$($(arch)_XCC) $($(arch)_XCFLAGS) $(call bench_cflags,$(arch)) $(SRC) \
+	$< -lrt -lm -o $@
+	$($(arch)_XSTRIP) $@
+
+$(XPROG)_bench_multi: arch := $(ARCH)
+$(XPROG)_bench_multi: isa_list := $(ISA_LIST)
+$(XPROG)_bench_multi: tu_bench.c $(SRC) $(HEADER) $(XSPECS)
+	$($(arch)_XCC) $($(arch)_XCFLAGS) $(call bench_cflags,$(arch)) \
+	$(SPEC_LIST) $(isa_list) $(SRC) $(filter %.o,$^) $< -lrt -lm -o $@
+	$($(arch)_XSTRIP) $@
+
+$(XPROG)_bitorder: arch := $(ARCH)
+$(XPROG)_bitorder: isa_list := $(ISA_LIST)
+$(XPROG)_bitorder: tu_bitorder.c $(SRC) $(HEADER) $(XSPECS)
+	$($(arch)_XCC) $($(arch)_XCFLAGS) $(SPEC_LIST) $(isa_list) \
+	$(filter %.o,$^) $< -o $@
+	$($(arch)_XSTRIP) $@
+
+$(XPROG)_spec_%.o: arch := $(ARCH)
+$(XPROG)_spec_%.o: ../../lib/bch_spec.c $(SRC) $(HEADER)
+	$($(arch)_XCC) $($(arch)_XCFLAGS) -DBCH_SPEC_M=$(call spec_m,$*) \
+	-DBCH_SPEC_T=$(call spec_t,$*) -c $< -o $@
+
+$(XPROG)_isa_%.o: arch := $(ARCH)
+$(XPROG)_isa_%.o: ../../lib/bch_spec.c $(SRC) $(HEADER)
+	$($(arch)_XCC) $($(arch)_XCFLAGS) $(ISA_$*) -DBCH_SPEC_ISA=$* \
+	-c $< -o $@
+
+$(XPROG)_baseline: arch := $(ARCH)
+$(XPROG)_baseline: tu_baseline.c
+	$($(arch)_XCC) $($(arch)_XCFLAGS) $< -lm -o $@
+	$($(arch)_XSTRIP) $@
+
+$(XPROG)_correct_m20: arch := $(ARCH)
+$(XPROG)_correct_m20: tu_correct.c $(SRC) $(HEADER)
+	$($(arch)_XCC) $($(arch)_XCFLAGS) $< -o $@
 	$($(arch)_XSTRIP) $@
 
 $(XPROG)_%: arch := $(ARCH)
@@ -30,13 +69,27 @@ $(XPROG)_bench_m13t4:  $(ARCH)_XCFLAGS += $(M13T4)
 $(XPROG)_bench_m13t4c: $(ARCH)_XCFLAGS += $(M13T4) $(CHIEN)
 $(XPROG)_bench_m13t8:  $(ARCH)_XCFLAGS += $(M13T8)
 $(XPROG)_bench_m13t8c: $(ARCH)_XCFLAGS += $(M13T8) $(CHIEN)
+$(XPROG)_bench_m13t4tab: $(ARCH)_XCFLAGS += $(M13T4TAB)
+$(XPROG)_bench_m13t4tab: gen_m13t4/bch_const_tables.h
+$(XPROG)_bench_m13t8tab: $(ARCH)_XCFLAGS += $(M13T8TAB)
+$(XPROG)_bench_m13t8tab: gen_m13t8/bch_const_tables.h
+$(XPROG)_bench_stats:  $(ARCH)_XCFLAGS += $(STATS)
+$(XPROG)_bench_m20:    $(ARCH)_XCFLAGS += $(MAXM20)
+
+# tests covering m > 16
+$(XPROG)_tool $(XPROG)_gf $(XPROG)_mem $(XPROG)_poly4: \
+	$(ARCH)_XCFLAGS += $(MAXM20)
+$(XPROG)_micro $(XPROG)_prim $(XPROG)_correct_m20: \
+	$(ARCH)_XCFLAGS += $(MAXM20)
+
+$(XPROG)_engine: ../../lib/bch_engine.c ../../include/linux/bch_engine.h
 
 $(XPROG)_%.sh: arch := $(ARCH)
 $(XPROG)_%.sh: tu_%.sh.template $(XPROGS)
 	@sed \
-	-e 's|@XSHELL|$($(arch)_XSHELL)|' \
-	-e 's|@XPROG|$($(arch)_XPROG)|' \
-	-e 's|@XRUN|$($(arch)_XRUN)|' > $@ < $<
+	-e 's|@XSHELL|$($(arch)_XSHELL)|g' \
+	-e 's|@XPROG|$($(arch)_XPROG)|g' \
+	-e 's|@XRUN|$($(arch)_XRUN)|g' > $@ < $<
 	@chmod a+x $@
 
 $(ARCH): $(XPROGS) $(XSCRIPTS)
@@ -0,0 +1 @@
+../../../../include/linux/bch_engine.h
\ No newline at end of file
@@ -0,0 +1,6 @@
+#ifndef _STANDALONE_CACHE_H
+#define _STANDALONE_CACHE_H
+
+#define L1_CACHE_BYTES         64
+
+#endif
@@ -11,6 +11,8 @@
 #define kfree(_ptr)            free(_ptr)
 #define ARRAY_SIZE(_a)         (sizeof(_a)/sizeof((_a)[0]))
 #define DIV_ROUND_UP(n,d)      (((n)+(d)-1)/(d))
+#define ALIGN(_x, _a)          (((_x)+(_a)-1) & ~((typeof(_x))(_a)-1))
+#define PTR_ALIGN(_p, _a)      ((typeof(_p))ALIGN((unsigned long)(_p), (_a)))
 #define EXPORT_SYMBOL_GPL(x)
 #define MODULE_LICENSE(x)
 #define MODULE_AUTHOR(x)
@@ -22,5 +24,7 @@
 #define cpu_to_be32(_x)        htonl(_x)
 
 #define fls(_x)                (32-__builtin_clz(_x))
+#define __ffs(_x)              __builtin_ctzl(_x)
+#define hweight32(_x)          __builtin_popcount(_x)
 
 #endif
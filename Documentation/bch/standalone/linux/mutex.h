@@ -0,0 +1,10 @@
+#ifndef _STANDALONE_MUTEX_H
+#define _STANDALONE_MUTEX_H
+
+#include <pthread.h>
+
+#define DEFINE_MUTEX(_m)       pthread_mutex_t _m = PTHREAD_MUTEX_INITIALIZER
+#define mutex_lock(_m)         pthread_mutex_lock(_m)
+#define mutex_unlock(_m)       pthread_mutex_unlock(_m)
+
+#endif
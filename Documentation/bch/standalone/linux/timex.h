@@ -0,0 +1,25 @@
+#ifndef _STANDALONE_TIMEX_H
+#define _STANDALONE_TIMEX_H
+
+#include <time.h>
+
+typedef unsigned long long cycles_t;
+
+static inline cycles_t get_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+	cycles_t c;
+
+	asm volatile("mrs %0, cntvct_el0" : "=r" (c));
+	return c;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000000000ull+ts.tv_nsec;
+#endif
+}
+
+#endif
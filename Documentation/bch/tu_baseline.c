@@ -0,0 +1,449 @@
+/*
+ * BCH library tests
+ *
+ * Benchmark baseline capture and regression check: run a tu_bench program
+ * several times with csv output, and either save per-metric statistics into
+ * a baseline file, or compare them against a previously saved baseline.
+ *
+ * Usage: ./tu_baseline [-n runs] [-t threshold] [-r runner] save|compare
+ *        <file> <bench> [args]
+ *
+ * -n: number of benchmark runs (default 5)
+ * -t: slowdown threshold in percent (default 5)
+ * -r: space-separated command prefix running the benchmark, e.g. an emulator
+ *  such as "qemu-arm -cpu arm926" (default none)
+ * <bench> [args]: benchmark command, e.g. ./tu_bench_dyn -e 0,4 13 4 1
+ *
+ * Results are keyed by (kernel, op, mode, m, t, len, e); metrics are average
+ * time per call, decoding stage times and latency percentiles. For each
+ * metric, the comparison computes a 95% confidence interval of the relative
+ * difference between baseline and new means (Welch's t-test), and reports a
+ * regression if the whole interval lies above the threshold, i.e. if the
+ * slowdown is both larger than the threshold and not explained by noise.
+ *
+ * Exit status is 0 if no regression was found, 1 otherwise, 2 on errors.
+ *
+ * Copyright (C) 2011 Parrot S.A.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <sys/wait.h>
+
+#define MAX_FIELDS     64
+#define MAX_LINE       4096
+#define MAX_RUNNER     16
+
+/* key fields, and metrics excluded from comparison (single extreme values) */
+static const char * const key_fields[] = {
+	"kernel", "op", "mode", "m", "t", "len", "e"
+};
+#define NKEYS  (int)(sizeof(key_fields)/sizeof(key_fields[0]))
+
+static const char * const skip_metrics[] = {"worst_us", "min_us"};
+
+struct metric {
+	char            key[128];
+	char            name[32];
+	unsigned int    n;
+	double          sum;
+	double          sumsq;
+	/* baseline statistics */
+	unsigned int    base_n;
+	double          base_mean;
+	double          base_sd;
+};
+
+static struct metric *metrics;
+static int nmetrics, maxmetrics;
+static char cpu[MAX_LINE];
+static char *runner[MAX_RUNNER];
+static int nrunner;
+
+static void die(const char *msg)
+{
+	fprintf(stderr, "tu_baseline: %s\n", msg);
+	exit(2);
+}
+
+static struct metric *get_metric(const char *key, const char *name)
+{
+	int i;
+	struct metric *p;
+
+	for (i = 0; i < nmetrics; i++) {
+		if (!strcmp(metrics[i].key, key) &&
+		    !strcmp(metrics[i].name, name))
+			return &metrics[i];
+	}
+	if (nmetrics == maxmetrics) {
+		maxmetrics = maxmetrics ? 2*maxmetrics : 256;
+		metrics = realloc(metrics, maxmetrics*sizeof(*metrics));
+		if (!metrics)
+			die("out of memory");
+	}
+	p = &metrics[nmetrics++];
+	memset(p, 0, sizeof(*p));
+	snprintf(p->key, sizeof(p->key), "%s", key);
+	snprintf(p->name, sizeof(p->name), "%s", name);
+	return p;
+}
+
+static double mean(const struct metric *p)
+{
+	return p->n ? p->sum/p->n : 0.0;
+}
+
+static double stddev(const struct metric *p)
+{
+	double v;
+
+	if (p->n < 2)
+		return 0.0;
+	v = (p->sumsq-p->sum*p->sum/p->n)/(p->n-1);
+	return (v > 0.0) ? sqrt(v) : 0.0;
+}
+
+/* split a csv line in place, handling quoted fields */
+static int split_csv(char *line, char **fields)
+{
+	int n = 0;
+	char *r = line, *w;
+
+	line[strcspn(line, "\r\n")] = '\0';
+	while (n < MAX_FIELDS) {
+		fields[n++] = w = r;
+		if (*r == '"') {
+			for (r++; *r; r++) {
+				if (*r == '"') {
+					if (r[1] != '"')
+						break;
+					r++;
+				}
+				*w++ = *r;
+			}
+			if (*r)
+				r++;
+		} else {
+			while (*r && (*r != ','))
+				*w++ = *r++;
+		}
+		if (*r != ',') {
+			*w = '\0';
+			break;
+		}
+		*w = '\0';
+		r++;
+	}
+	return n;
+}
+
+static int find_field(char **names, int n, const char *name)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (!strcmp(names[i], name))
+			return i;
+	}
+	return -1;
+}
+
+static int is_metric(const char *name)
+{
+	unsigned int i;
+	size_t len = strlen(name);
+
+	if ((len < 4) || strcmp(name+len-3, "_us"))
+		return 0;
+	for (i = 0; i < sizeof(skip_metrics)/sizeof(skip_metrics[0]); i++) {
+		if (!strcmp(name, skip_metrics[i]))
+			return 0;
+	}
+	return 1;
+}
+
+/* split runner command prefix into words */
+static void set_runner(char *cmd)
+{
+	char *word;
+
+	for (word = strtok(cmd, " \t"); word; word = strtok(NULL, " \t")) {
+		if (nrunner == MAX_RUNNER)
+			die("runner command too long");
+		runner[nrunner++] = word;
+	}
+}
+
+/*
+ * start benchmark in csv mode, behind the runner if any, with its output
+ * connected to the returned stream and its error output discarded
+ */
+static FILE *start_bench(int argc, char *argv[], pid_t *pid)
+{
+	int i, fd[2], null, nargs = 0;
+	char *args[nrunner+argc+3];
+	FILE *fp;
+
+	for (i = 0; i < nrunner; i++) {
+		args[nargs++] = runner[i];
+	}
+	/* insert csv option right after the program name */
+	args[nargs++] = argv[0];
+	args[nargs++] = "-f";
+	args[nargs++] = "csv";
+	for (i = 1; i < argc; i++) {
+		args[nargs++] = argv[i];
+	}
+	args[nargs] = NULL;
+
+	if (pipe(fd))
+		die("cannot create pipe");
+	*pid = fork();
+	if (*pid < 0)
+		die("cannot fork");
+	if (*pid == 0) {
+		null = open("/dev/null", O_WRONLY);
+		if ((null < 0) || (dup2(fd[1], 1) < 0) || (dup2(null, 2) < 0))
+			_exit(127);
+		close(fd[0]);
+		close(fd[1]);
+		close(null);
+		execvp(args[0], args);
+		_exit(127);
+	}
+	close(fd[1]);
+	fp = fdopen(fd[0], "r");
+	if (!fp)
+		die("cannot read benchmark output");
+	return fp;
+}
+
+/* run benchmark once in csv mode, and accumulate its metrics */
+static void run_bench(int argc, char *argv[])
+{
+	int i, n, status, nnames = 0, keyidx[NKEYS], cpuidx = -1;
+	char header[MAX_LINE], line[MAX_LINE], key[128];
+	char *names[MAX_FIELDS], *fields[MAX_FIELDS], *end;
+	struct metric *p;
+	size_t len;
+	double v;
+	pid_t pid;
+	FILE *fp;
+
+	fp = start_bench(argc, argv, &pid);
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (!nnames) {
+			strcpy(header, line);
+			nnames = split_csv(header, names);
+			for (i = 0; i < NKEYS; i++) {
+				keyidx[i] = find_field(names, nnames,
+						       key_fields[i]);
+				if (keyidx[i] < 0)
+					die("unexpected benchmark output");
+			}
+			cpuidx = find_field(names, nnames, "cpu");
+			continue;
+		}
+		n = split_csv(line, fields);
+		if (n != nnames)
+			die("malformed benchmark output");
+		if ((cpuidx >= 0) && !cpu[0])
+			snprintf(cpu, sizeof(cpu), "%s", fields[cpuidx]);
+
+		for (i = 0, len = 0; i < NKEYS; i++) {
+			len += snprintf(key+len, sizeof(key)-len, "%s%s=%s",
+					i ? ":" : "", key_fields[i],
+					fields[keyidx[i]]);
+			if (len >= sizeof(key))
+				die("key too long");
+		}
+		for (i = 0; i < n; i++) {
+			if (!is_metric(names[i]) || !fields[i][0])
+				continue;
+			v = strtod(fields[i], &end);
+			if (*end)
+				die("malformed benchmark value");
+			p = get_metric(key, names[i]);
+			p->n++;
+			p->sum += v;
+			p->sumsq += v*v;
+		}
+	}
+	fclose(fp);
+	if ((waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) ||
+	    WEXITSTATUS(status) || !nnames)
+		die("benchmark failed");
+}
+
+static void save_baseline(const char *path)
+{
+	int i;
+	FILE *fp;
+
+	fp = fopen(path, "w");
+	if (!fp)
+		die("cannot create baseline file");
+	fprintf(fp, "# cpu: %s\n", cpu);
+	for (i = 0; i < nmetrics; i++) {
+		fprintf(fp, "%s %s %u %.9g %.9g\n", metrics[i].key,
+			metrics[i].name, metrics[i].n, mean(&metrics[i]),
+			stddev(&metrics[i]));
+	}
+	if (fclose(fp))
+		die("cannot write baseline file");
+	fprintf(stderr, "saved %d metrics into %s\n", nmetrics, path);
+}
+
+static void load_baseline(const char *path)
+{
+	char line[MAX_LINE], key[128], name[32];
+	unsigned int n;
+	double m, sd;
+	struct metric *p;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp)
+		die("cannot open baseline file");
+	while (fgets(line, sizeof(line), fp)) {
+		if (!strncmp(line, "# cpu: ", 7)) {
+			line[strcspn(line, "\n")] = '\0';
+			if (strcmp(line+7, cpu))
+				fprintf(stderr, "warning: baseline cpu '%s' "
+					"differs from '%s'\n", line+7, cpu);
+			continue;
+		}
+		if (sscanf(line, "%127s %31s %u %lf %lf", key, name, &n, &m,
+			   &sd) != 5)
+			die("malformed baseline file");
+		p = get_metric(key, name);
+		p->base_n = n;
+		p->base_mean = m;
+		p->base_sd = sd;
+	}
+	fclose(fp);
+}
+
+/* two-sided 95% quantile of Student's t distribution */
+static double t95(double df)
+{
+	static const double q[] = {
+		12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+		2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120,
+		2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+		2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+	};
+	int i = (int)floor(df);
+
+	if (i < 1)
+		i = 1;
+	return (i <= 30) ? q[i-1] : 1.96;
+}
+
+static int compare_baseline(double threshold)
+{
+	int i, nreg = 0, ncmp = 0;
+	double m, va, vb, se, df, lo, hi;
+	struct metric *p;
+
+	for (i = 0; i < nmetrics; i++) {
+		p = &metrics[i];
+		if (!p->n || !p->base_n) {
+			fprintf(stderr, "missing:%s:%s\n", p->key, p->name);
+			continue;
+		}
+		if (p->base_mean <= 0.0)
+			continue;
+		ncmp++;
+		m = mean(p);
+		/* Welch's t-test on the difference of means */
+		va = p->base_sd*p->base_sd/p->base_n;
+		vb = stddev(p)*stddev(p)/p->n;
+		se = sqrt(va+vb);
+		df = 1.0;
+		if ((p->base_n > 1) && (p->n > 1) && (se > 0.0))
+			df = (va+vb)*(va+vb)/(va*va/(p->base_n-1)+
+					      vb*vb/(p->n-1));
+		lo = (m-p->base_mean-t95(df)*se)*100.0/p->base_mean;
+		hi = (m-p->base_mean+t95(df)*se)*100.0/p->base_mean;
+
+		if (lo > threshold)
+			nreg++;
+		printf("%s:%s:%s:base=%g:new=%g:delta=%+.1f%%:"
+		       "ci=[%+.1f%%,%+.1f%%]\n", (lo > threshold) ?
+		       "regression" : "ok", p->key, p->name, p->base_mean, m,
+		       (m-p->base_mean)*100.0/p->base_mean, lo, hi);
+	}
+	fprintf(stderr, "%d metrics compared, %d regressions beyond %g%%\n",
+		ncmp, nreg, threshold);
+	return nreg ? 1 : 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-n runs] [-t threshold] [-r runner] "
+		"save|compare <file> <bench> [args]\n", prog);
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	int c, i, save, runs = 5;
+	double threshold = 5.0;
+
+	while ((c = getopt(argc, argv, "+n:t:r:")) != -1) {
+		switch (c) {
+		case 'n':
+			runs = atoi(optarg);
+			break;
+		case 't':
+			threshold = atof(optarg);
+			break;
+		case 'r':
+			set_runner(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if ((argc-optind < 3) || (runs < 1))
+		usage(argv[0]);
+	if (!strcmp(argv[optind], "save"))
+		save = 1;
+	else if (!strcmp(argv[optind], "compare"))
+		save = 0;
+	else
+		usage(argv[0]);
+
+	for (i = 0; i < runs; i++) {
+		fprintf(stderr, "run %d/%d\n", i+1, runs);
+		run_bench(argc-optind-2, argv+optind+2);
+	}
+
+	if (save) {
+		save_baseline(argv[optind+1]);
+		return 0;
+	}
+	load_baseline(argv[optind+1]);
+	return compare_baseline(threshold);
+}
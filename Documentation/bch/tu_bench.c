@@ -3,11 +3,41 @@
  *
  * Benchmarking and verification on random error vectors.
  *
- * Usage: ./tu_bench <m> <t> <sec>
+ * Usage: ./tu_bench [-f text|csv|json] [-l len] [-e nerr] [-L [-C clock]
+ *                   [-c cpu]] <m> <t> <sec>
  *
  * <m>: value for parameter m
  * <t>: value for parameter t
- * <sec>: target duration of a single (m,t) run
+ * <sec>: target duration of a single measurement point
+ * -f: output format; text is printed on stderr, csv and json on stdout
+ * -l: data lengths in bytes (default 2^(m-1)/8)
+ * -e: error counts (default 0 to t)
+ * -L: latency mode, see below
+ * -C: latency clock, "cycles" (cpu cycle counter, default) or "raw"
+ *     (CLOCK_MONOTONIC_RAW)
+ * -c: cpu to run on in latency mode (default: current cpu)
+ *
+ * Parameters m, t, and options -l and -e accept lists of values and ranges,
+ * e.g. "13,14" or "2-8"; the benchmark sweeps all valid (m,t,len,nerr)
+ * combinations. For each (m,t,len), it measures:
+ * - encoding of aligned and unaligned data
+ * - decoding of received ecc (mode "ecc") and data (mode "data") for each
+ *   error count, the latter split by stage: ecc computation, syndromes, and
+ *   error location; error location is further split into error locator
+ *   polynomial and root finding if the library has CONFIG_BCH_STATS.
+ *
+ * In latency mode, the benchmark instead times every single decoding of data
+ * (each with a new random error vector) on a pinned cpu, records timings into
+ * a histogram per error count, and prints a table of percentiles. Unlike
+ * averages, this exposes outliers due to data dependent branches of the
+ * decoder, such as Berlekamp-Massey iterations or BTZ recursion depth.
+ * Histogram buckets are log-linear, as in HDR histograms: each power of two
+ * is split into 32 sub-buckets, i.e. values are recorded within about 3%.
+ *
+ * Times are wall clock microseconds per call, throughputs are in Mbit/s.
+ * Machine readable outputs also record the cpu model, compiler flags and
+ * library variant, so that results of different builds and targets can be
+ * compared.
  *
  * Copyright (C) 2011 Parrot S.A.
  *
@@ -26,6 +56,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -33,29 +64,185 @@
 #include <time.h>
 #include <math.h>
 #include <assert.h>
+#include <sched.h>
 #include <arpa/inet.h>
 
 #include "linux/bch.h"
+#include "linux/timex.h"
 
 #define MIN_ITER_US    10000
 #define MAX_LOOP_MS    10000
+#define MAX_LIST       256
+
+#ifndef BENCH_CFLAGS
+#define BENCH_CFLAGS   "unknown"
+#endif
+
+enum { FMT_TEXT, FMT_CSV, FMT_JSON };
+
+enum {
+	STAGE_ECC,      /* ecc computation */
+	STAGE_SYN,      /* syndrome computation */
+	STAGE_LOC,      /* error location */
+	STAGE_ELP,      /* error locator polynomial, part of STAGE_LOC */
+	STAGE_ROOTS,    /* root finding, part of STAGE_LOC */
+	NSTAGES
+};
+
+static const char * const stage_names[NSTAGES] = {
+	"ecc", "syn", "loc", "elp", "roots"
+};
+
+/* percentiles reported in latency mode */
+#define NPCT 5
+static const double pct_values[NPCT] = {50.0, 90.0, 99.0, 99.9, 99.99};
+static const char * const pct_names[NPCT] = {
+	"p50", "p90", "p99", "p99.9", "p99.99"
+};
+static const char * const pct_keys[NPCT] = {
+	"p50", "p90", "p99", "p999", "p9999"
+};
+
+/* log-linear latency histogram, with HIST_SUB sub-buckets per power of two */
+#define HIST_SUB_BITS  5
+#define HIST_SUB       (1 << HIST_SUB_BITS)
+#define HIST_NBUCKETS  ((64-HIST_SUB_BITS+1)*HIST_SUB)
+
+struct latency_hist {
+	uint64_t        count[HIST_NBUCKETS];
+	uint64_t        n;
+	uint64_t        min;
+	uint64_t        max;
+	double          sum;
+};
+
+/* a single measurement point */
+struct bench_result {
+	const char     *op;             /* encode or decode */
+	const char     *mode;           /* aligned, unaligned, ecc or data */
+	const char     *kernel;
+	int             m, t, len, e;
+	double          avg, worst;     /* time per call in us */
+	int             nstages;        /* number of valid stage[] entries */
+	double          stage[NSTAGES]; /* time per call in us */
+	int             npct;           /* number of valid pct[] entries */
+	uint64_t        samples;        /* latency mode sample count */
+	double          best;           /* latency mode minimum in us */
+	double          pct[NPCT];      /* latency mode percentiles in us */
+};
+
+#if defined(CONFIG_BCH_CONST_PARAMS)
+static const int cst = 1;
+#else
+static const int cst = 0;
+#endif
+
+#if defined(CONFIG_BCH_STATS)
+static const int has_stats = 1;
+#else
+static const int has_stats = 0;
+#endif
+
+static int format = FMT_TEXT;
+static int nresults;
+static char cpu[128] = "unknown";
+
+static int latency;
+static int raw_clock;
+static double tick_ns = 1.0;
 
 static struct timespec ts1;
 static struct timespec ts2;
 
 static inline void start_measure(void)
 {
-	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts1);
+	clock_gettime(CLOCK_MONOTONIC, &ts1);
 }
 
 static inline double stop_measure(void)
 {
 	double d;
-	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts2);
+	clock_gettime(CLOCK_MONOTONIC, &ts2);
 	d = (ts2.tv_sec-ts1.tv_sec)*1000000.0+(ts2.tv_nsec-ts1.tv_nsec)/1000.0;
 	return d;
 }
 
+static inline uint64_t raw_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return ts.tv_sec*1000000000ull+ts.tv_nsec;
+}
+
+/* latency clock, in ticks of tick_ns nanoseconds */
+static inline uint64_t latency_clock(void)
+{
+	return raw_clock ? raw_ns() : get_cycles();
+}
+
+static void calibrate_clock(void)
+{
+	uint64_t t0, c0;
+
+	if (raw_clock)
+		return;
+	t0 = raw_ns();
+	c0 = get_cycles();
+	while (raw_ns()-t0 < 50000000ull)
+		;
+	tick_ns = (raw_ns()-t0)/(double)(get_cycles()-c0);
+	fprintf(stderr, "clock: cycles, %g MHz\n", 1000.0/tick_ns);
+}
+
+static unsigned int hist_index(uint64_t v)
+{
+	unsigned int shift;
+
+	if (v < 2*HIST_SUB)
+		return v;
+	shift = 63-__builtin_clzll(v)-HIST_SUB_BITS;
+	return shift*HIST_SUB+(unsigned int)(v >> shift);
+}
+
+/* highest value recorded in a bucket */
+static uint64_t hist_value(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < 2*HIST_SUB)
+		return idx;
+	shift = idx/HIST_SUB-1;
+	return ((uint64_t)(idx-shift*HIST_SUB+1) << shift)-1;
+}
+
+static void hist_record(struct latency_hist *h, uint64_t v)
+{
+	h->count[hist_index(v)]++;
+	if (!h->n || (v < h->min))
+		h->min = v;
+	if (v > h->max)
+		h->max = v;
+	h->sum += v;
+	h->n++;
+}
+
+static uint64_t hist_percentile(const struct latency_hist *h, double p)
+{
+	unsigned int i;
+	uint64_t cum = 0, target = (uint64_t)ceil(p*h->n/100.0);
+
+	if (!target)
+		target = 1;
+	for (i = 0; i < HIST_NBUCKETS; i++) {
+		cum += h->count[i];
+		if (cum >= target)
+			break;
+	}
+	return (i < HIST_NBUCKETS) && (hist_value(i) < h->max) ?
+		hist_value(i) : h->max;
+}
+
 static inline unsigned int rev8(unsigned int x)
 {
 	return (x & ~7)|(7-(x & 7));
@@ -166,6 +353,49 @@ static double check_vector(struct bch_control *bch, uint8_t *data, int len,
 	return d;
 }
 
+/*
+ * time decoding stages separately through the public interface; if decoding
+ * statistics are available, use their cycle counts to split error location
+ * into elp and root finding
+ */
+static void check_stages(struct bch_control *bch, uint8_t *data, int len,
+			 const unsigned int *vec, int vecsize, int niter,
+			 double *stage, double *cycles)
+{
+	int i, nerrors = 0;
+	unsigned int errloc[bch->t], syn[2*bch->t];
+	struct bch_stats stats;
+
+	corrupt_data(data, vec, vecsize);
+
+	start_measure();
+	for (i = 0; i < niter; i++) {
+		encode_bch(bch, data, len, NULL);
+	}
+	stage[STAGE_ECC] += stop_measure();
+
+	/* syndrome computation includes ecc computation, subtracted later */
+	start_measure();
+	for (i = 0; i < niter; i++) {
+		compute_syndromes_bch(bch, data, len, data+len, syn);
+	}
+	stage[STAGE_SYN] += stop_measure();
+
+	bch_reset_stats(bch);
+	start_measure();
+	for (i = 0; i < niter; i++) {
+		nerrors = decode_bch(bch, NULL, len, NULL, NULL, syn, errloc);
+	}
+	stage[STAGE_LOC] += stop_measure();
+	if (bch_get_stats(bch, &stats) == 0) {
+		cycles[0] += stats.cycles[BCH_STAGE_ELP];
+		cycles[1] += stats.cycles[BCH_STAGE_ROOTS];
+	}
+
+	corrupt_data(data, vec, vecsize);
+	compare_vectors(vec, vecsize, errloc, nerrors);
+}
+
 static void calibrate(struct bch_control *bch, uint8_t *data, unsigned int len,
 		      int ms, int *niter, int *nsamples)
 {
@@ -190,66 +420,283 @@ static void calibrate(struct bch_control *bch, uint8_t *data, unsigned int len,
 
 	/* compute number of samples */
 	*nsamples = d? (int)floor(ms*100000.0/(d*(*niter))) : 10000;
+	if (!*nsamples) {
+		*nsamples = 1;
+	}
 
 	fprintf(stderr, "calibration: iter=%gs niter=%d nsamples=%d\n",
 		d/100.0, *niter, *nsamples);
 }
 
-static void bch_test_bench(int m, int t, int ms)
+static void read_cpu_model(void)
 {
-	int i, len, vecsize, cache, niter, nsamples;
-	struct bch_control *bch;
-	unsigned int vec[t];
-	uint8_t *data;
-	double d, dsum, dmax, avg;
+	static const char * const names[] = {
+		"model name\t: ",       /* x86 */
+		"Processor\t: ",        /* older arm */
+		"cpu model\t\t: ",      /* mips */
+		"cpu\t\t: ",            /* powerpc */
+	};
+	char buf[128];
+	unsigned int i;
 	FILE *fp;
+
+	fp = fopen("/proc/cpuinfo", "r");
+	if (!fp)
+		return;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		for (i = 0; i < sizeof(names)/sizeof(names[0]); i++) {
+			if (!strncmp(names[i], buf, strlen(names[i]))) {
+				snprintf(cpu, sizeof(cpu), "%s",
+					 buf+strlen(names[i]));
+				cpu[strcspn(cpu, "\n")] = '\0';
+				fclose(fp);
+				return;
+			}
+		}
+	}
+	fclose(fp);
+}
+
+static const char *variant_params(void)
+{
 #if defined(CONFIG_BCH_CONST_PARAMS)
-	static const int cst = 1;
+	static char buf[32];
+
+	snprintf(buf, sizeof(buf), "m%dt%d", CONFIG_BCH_CONST_M,
+		 CONFIG_BCH_CONST_T);
+	return buf;
 #else
-	static const int cst = 0;
+	return "dynamic";
 #endif
+}
 
-	fp = fopen("/proc/cpuinfo", "r");
-	if (fp) {
-		char buf[128];
-		const char *const name1 = "model name\t: ";
-		const char *const name2 = "Processor\t: ";
-		while (fgets(buf, sizeof(buf), fp)) {
-			if (!strncmp(name1, buf, strlen(name1))) {
-				fprintf(stderr, "cpu: %s", buf+strlen(name1));
-				break;
+static const char *variant_tables(void)
+{
+#if defined(CONFIG_BCH_CONST_TABLES)
+	return "const";
+#else
+	return "runtime";
+#endif
+}
+
+static const char *variant_roots(void)
+{
+#if defined(USE_CHIEN_SEARCH)
+	return "chien";
+#else
+	return "btz";
+#endif
+}
+
+/* print a string literal, escaping characters as needed by json and csv */
+static void print_str(const char *s)
+{
+	putchar('"');
+	for (; *s; s++) {
+		if ((format == FMT_JSON) && ((*s == '"') || (*s == '\\')))
+			putchar('\\');
+		else if ((format == FMT_CSV) && (*s == '"'))
+			putchar('"');
+		putchar(*s);
+	}
+	putchar('"');
+}
+
+static void print_begin(void)
+{
+	int i;
+
+	fprintf(stderr, "cpu: %s\n", cpu);
+	fprintf(stderr, "variant: params=%s tables=%s roots=%s stats=%d\n",
+		variant_params(), variant_tables(), variant_roots(),
+		has_stats);
+
+	switch (format) {
+	case FMT_CSV:
+		printf("cpu,compiler,cflags,params,tables,roots,kernel,op,mode,"
+		       "m,t,len,e,avg_us,worst_us,thr_mbit");
+		for (i = 0; i < NSTAGES; i++) {
+			printf(",%s_us", stage_names[i]);
+		}
+		printf(",samples,min_us");
+		for (i = 0; i < NPCT; i++) {
+			printf(",%s_us", pct_keys[i]);
+		}
+		printf("\n");
+		break;
+	case FMT_JSON:
+		printf("{\n  \"meta\": {\n    \"cpu\": ");
+		print_str(cpu);
+		printf(",\n    \"compiler\": ");
+		print_str(__VERSION__);
+		printf(",\n    \"cflags\": ");
+		print_str(BENCH_CFLAGS);
+		printf(",\n    \"endian\": \"%s\",\n",
+		       (htonl(0x01020304) == 0x01020304)? "big" : "little");
+		printf("    \"params\": \"%s\",\n    \"tables\": \"%s\",\n"
+		       "    \"roots\": \"%s\",\n    \"stats\": %s,\n",
+		       variant_params(), variant_tables(), variant_roots(),
+		       has_stats ? "true" : "false");
+		printf("    \"clock\": \"%s\",\n    \"tick_ns\": %g\n  },\n"
+		       "  \"results\": [", latency ? (raw_clock ? "raw" :
+		       "cycles") : "monotonic", tick_ns);
+		break;
+	}
+}
+
+static void print_result(const struct bench_result *r)
+{
+	int i;
+	const double thr = r->avg ? r->len*8.0/r->avg : 0.0;
+
+	switch (format) {
+	case FMT_TEXT:
+		if (r->npct) {
+			fprintf(stderr, "%6d %10llu %9.3f %9.3f", r->e,
+				(unsigned long long)r->samples, r->avg,
+				r->best);
+			for (i = 0; i < r->npct; i++) {
+				fprintf(stderr, " %9.3f", r->pct[i]);
 			}
-			if (!strncmp(name2, buf, strlen(name2))) {
-				fprintf(stderr, "cpu: %s", buf+strlen(name2));
-				break;
+			fprintf(stderr, " %9.3f\n", r->worst);
+			break;
+		}
+		fprintf(stderr, "%s:const=%d:m=%d:t=%d:len=%d:", r->op, cst,
+			r->m, r->t, r->len);
+		if (r->e >= 0)
+			fprintf(stderr, "e=%d:enc=%d:", r->e,
+				!strcmp(r->mode, "data"));
+		else
+			fprintf(stderr, "align=%d:",
+				!strcmp(r->mode, "aligned"));
+		fprintf(stderr, "avg=%g:worst=%g:avg_thr=%d", r->avg,
+			r->worst, (int)floor(thr));
+		for (i = 0; i < r->nstages; i++) {
+			fprintf(stderr, ":%s=%g", stage_names[i],
+				r->stage[i]);
+		}
+		fprintf(stderr, "\n");
+		break;
+	case FMT_CSV:
+		print_str(cpu);
+		printf(",");
+		print_str(__VERSION__);
+		printf(",");
+		print_str(BENCH_CFLAGS);
+		printf(",%s,%s,%s,%s,%s,%s,%d,%d,%d,%d,%g,%g,%g",
+		       variant_params(), variant_tables(), variant_roots(),
+		       r->kernel, r->op, r->mode, r->m, r->t, r->len, r->e,
+		       r->avg, r->worst, thr);
+		for (i = 0; i < NSTAGES; i++) {
+			if (i < r->nstages)
+				printf(",%g", r->stage[i]);
+			else
+				printf(",");
+		}
+		if (r->npct) {
+			printf(",%llu,%g", (unsigned long long)r->samples,
+			       r->best);
+			for (i = 0; i < r->npct; i++) {
+				printf(",%g", r->pct[i]);
+			}
+		} else {
+			printf(",,");
+			for (i = 0; i < NPCT; i++) {
+				printf(",");
+			}
+		}
+		printf("\n");
+		break;
+	case FMT_JSON:
+		printf("%s\n    {\"kernel\": \"%s\", \"op\": \"%s\", "
+		       "\"mode\": \"%s\", \"m\": %d, \"t\": %d, \"len\": %d, "
+		       "\"e\": %d,\n     \"avg_us\": %g, \"worst_us\": %g, "
+		       "\"thr_mbit\": %g", nresults ? "," : "", r->kernel,
+		       r->op, r->mode, r->m, r->t, r->len, r->e, r->avg,
+		       r->worst, thr);
+		for (i = 0; i < r->nstages; i++) {
+			printf(", \"%s_us\": %g", stage_names[i], r->stage[i]);
+		}
+		if (r->npct) {
+			printf(",\n     \"samples\": %llu, \"min_us\": %g",
+			       (unsigned long long)r->samples, r->best);
+			for (i = 0; i < r->npct; i++) {
+				printf(", \"%s_us\": %g", pct_keys[i],
+				       r->pct[i]);
 			}
 		}
-		fclose(fp);
+		printf("}");
+		break;
 	}
+	nresults++;
+}
 
-	bch = init_bch(m, t, 0);
-	assert(bch);
+static void print_end(void)
+{
+	if (format == FMT_JSON)
+		printf("\n  ]\n}\n");
+	fflush(stdout);
+}
 
-	srand48(m);
-	len = (1 << (m-1))/8;
+static void bench_encode(struct bch_control *bch, uint8_t *buf, int len,
+			 int ms, struct bench_result *r)
+{
+	int i, align, niter;
+	uint8_t ecc[bch->ecc_bytes], *data;
+	double d;
 
-	data = malloc(len+bch->ecc_bytes);
-	assert(data);
+	r->op = "encode";
+	r->e = -1;
+	r->nstages = 0;
 
-	/* prepare data buffer */
-	for (i = 0; i < len; i++) {
-		data[i] = lrand48() & 0xff;
+	for (align = 1; align >= 0; align--) {
+		/* unaligned data starts at an odd address */
+		data = align ? buf : buf+1;
+
+		start_measure();
+		for (i = 0; i < 100; i++) {
+			encode_bch(bch, data, len, ecc);
+		}
+		d = stop_measure();
+		niter = d ? (int)floor(ms*100000.0/d) : 100000;
+		if (!niter) {
+			niter = 1;
+		}
+
+		start_measure();
+		for (i = 0; i < niter; i++) {
+			encode_bch(bch, data, len, ecc);
+		}
+		r->avg = stop_measure()/niter;
+		r->worst = r->avg;
+		r->mode = align ? "aligned" : "unaligned";
+		print_result(r);
 	}
-	memset(data+len, 0, bch->ecc_bytes);
-	encode_bch(bch, data, len, data+len);
+}
+
+static void bench_decode(struct bch_control *bch, uint8_t *data, int len,
+			 int ms, const int *elist, int ne,
+			 struct bench_result *r)
+{
+	int i, j, k, cache, niter, nsamples, nstage, vecsize;
+	unsigned int vec[bch->t];
+	double d, dsum, dmax, cycles[2];
 
 	/* calibrate loops */
 	calibrate(bch, data, len, ms, &niter, &nsamples);
+	/* stages are timed on a quarter of samples */
+	nstage = (nsamples+3)/4;
+
+	r->op = "decode";
 
 	for (cache = 1; cache >= 0; cache--) {
-		for (vecsize = 0; vecsize <= t; vecsize++) {
+		for (j = 0; j < ne; j++) {
+			vecsize = elist[j];
 			dmax = 0.0;
 			dsum = 0.0;
+			memset(r->stage, 0, sizeof(r->stage));
+			memset(cycles, 0, sizeof(cycles));
 			for (i = 0; i < nsamples; i++) {
 				if (vecsize) {
 					generate_random_vector(bch, len, vec,
@@ -261,41 +708,280 @@ static void bch_test_bench(int m, int t, int ms)
 					dmax = d;
 				}
 				dsum += d;
+				if (!cache && (i < nstage)) {
+					check_stages(bch, data, len, vec,
+						     vecsize, niter, r->stage,
+						     cycles);
+				}
+			}
+			r->mode = cache ? "ecc" : "data";
+			r->e = vecsize;
+			r->avg = dsum/(1.0*nsamples*niter);
+			r->worst = dmax/(1.0*niter);
+			r->nstages = 0;
+			if (!cache) {
+				for (k = 0; k <= STAGE_LOC; k++) {
+					r->stage[k] /= 1.0*nstage*niter;
+				}
+				/* keep syndrome computation only */
+				r->stage[STAGE_SYN] -= r->stage[STAGE_ECC];
+				if (r->stage[STAGE_SYN] < 0.0) {
+					r->stage[STAGE_SYN] = 0.0;
+				}
+				r->nstages = STAGE_LOC+1;
+				if (cycles[0]+cycles[1] > 0.0) {
+					d = r->stage[STAGE_LOC]/
+						(cycles[0]+cycles[1]);
+					r->stage[STAGE_ELP] = cycles[0]*d;
+					r->stage[STAGE_ROOTS] = cycles[1]*d;
+					r->nstages = NSTAGES;
+				}
+			}
+			print_result(r);
+		}
+	}
+}
+
+/*
+ * time single decodings of data, each with a new random error vector, until
+ * ms milliseconds have elapsed for each error count
+ */
+static void bench_latency(struct bch_control *bch, uint8_t *data, int len,
+			  int ms, const int *elist, int ne,
+			  struct bench_result *r)
+{
+	int i, j, k, nerrors;
+	unsigned int vec[bch->t], errloc[bch->t];
+	struct latency_hist *h;
+	uint64_t c0, c1;
+	const double us = tick_ns/1000.0;
+
+	h = malloc(sizeof(*h));
+	assert(h);
+
+	r->op = "latency";
+	r->mode = "data";
+	r->nstages = 0;
+	if (format == FMT_TEXT) {
+		fprintf(stderr, "latency:const=%d:m=%d:t=%d:len=%d (us)\n"
+			"%6s %10s %9s %9s", cst, r->m, r->t, len, "errors",
+			"samples", "mean", "min");
+		for (i = 0; i < NPCT; i++) {
+			fprintf(stderr, " %9s", pct_names[i]);
+		}
+		fprintf(stderr, " %9s\n", "max");
+	}
+
+	for (j = 0; j < ne; j++) {
+		memset(h, 0, sizeof(*h));
+		start_measure();
+		do {
+			for (k = 0; k < 256; k++) {
+				generate_random_vector(bch, len, vec, elist[j]);
+				corrupt_data(data, vec, elist[j]);
+				c0 = latency_clock();
+				nerrors = decode_bch(bch, data, len, data+len,
+						     NULL, NULL, errloc);
+				c1 = latency_clock();
+				corrupt_data(data, vec, elist[j]);
+				compare_vectors(vec, elist[j], errloc,
+						nerrors);
+				hist_record(h, c1-c0);
 			}
-			avg = dsum/(1.0*nsamples*niter);
-			fprintf(stderr,
-				"decode:const=%d:m=%d:t=%d:e=%d:enc=%d:"
-				"avg=%g:worst=%g:avg_thr=%d\n", cst, m, t,
-				vecsize, !cache, avg, dmax/(1.0*niter),
-				avg? (int)floor(len*8.0/avg) : (int)0);
+		} while (stop_measure() < ms*1000.0);
+
+		r->e = elist[j];
+		r->samples = h->n;
+		r->avg = h->sum*us/h->n;
+		r->best = h->min*us;
+		r->worst = h->max*us;
+		for (i = 0; i < NPCT; i++) {
+			r->pct[i] = hist_percentile(h, pct_values[i])*us;
+		}
+		r->npct = NPCT;
+		print_result(r);
+	}
+	free(h);
+}
+
+static void bch_test_bench(int m, int t, int ms, const int *llist, int nl,
+			   const int *elist, int ne)
+{
+	int i, j, len, nerr, maxlen, elist_t[t+1];
+	struct bch_control *bch;
+	struct bench_result r;
+	uint8_t *data;
+
+	bch = init_bch(m, t, 0);
+	if (!bch) {
+		fprintf(stderr, "skipping unsupported m=%d t=%d\n", m, t);
+		return;
+	}
+	fprintf(stderr, "kernel: %s\n", bch_get_kernel(bch));
+
+	/* keep error counts supported by t */
+	for (i = 0, nerr = 0; i < ne; i++) {
+		if ((elist[i] >= 0) && (elist[i] <= t) && (nerr <= t))
+			elist_t[nerr++] = elist[i];
+	}
+	if (!ne) {
+		for (nerr = 0; nerr <= t; nerr++) {
+			elist_t[nerr] = nerr;
 		}
 	}
 
-	free(data);
+	maxlen = (bch->n-bch->ecc_bits)/8;
+	memset(&r, 0, sizeof(r));
+	r.kernel = bch_get_kernel(bch);
+	r.m = m;
+	r.t = t;
+
+	for (j = 0; j < (nl ? nl : 1); j++) {
+		len = nl ? llist[j] : (1 << (m-1))/8;
+		if ((len <= 0) || (len > maxlen)) {
+			fprintf(stderr, "skipping m=%d t=%d len=%d\n", m, t,
+				len);
+			continue;
+		}
+		srand48(m);
+
+		/* one extra byte for unaligned encoding */
+		data = malloc(len+bch->ecc_bytes+1);
+		assert(data);
+
+		/* prepare data buffer */
+		for (i = 0; i < len+1; i++) {
+			data[i] = lrand48() & 0xff;
+		}
+		memset(data+len, 0, bch->ecc_bytes);
+		encode_bch(bch, data, len, data+len);
+
+		r.len = len;
+		if (latency) {
+			bench_latency(bch, data, len, ms, elist_t, nerr, &r);
+		} else {
+			bench_encode(bch, data, len, ms, &r);
+			bench_decode(bch, data, len, ms, elist_t, nerr, &r);
+		}
+		free(data);
+	}
 	free_bch(bch);
 }
 
+/* parse a list of comma separated values and ranges, e.g. "4,8-10" */
+static int parse_list(const char *s, int *list, int max)
+{
+	int a, b, n = 0;
+	char *end;
+
+	while (*s) {
+		a = strtol(s, &end, 0);
+		if (end == s)
+			return -1;
+		b = a;
+		if (*end == '-') {
+			s = end+1;
+			b = strtol(s, &end, 0);
+			if (end == s)
+				return -1;
+		}
+		for (; (a <= b) && (n < max); a++) {
+			list[n++] = a;
+		}
+		if (*end == ',')
+			end++;
+		else if (*end)
+			return -1;
+		s = end;
+	}
+	return n;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-f text|csv|json] [-l len] [-e nerr] "
+		"[-L [-C cycles|raw] [-c cpu]] m t <sec>\n", prog);
+	exit(1);
+}
+
 int main(int argc, char *argv[])
 {
-	int m, t, nbits, ms;
+	int i, j, c, ms, nm, nt, nl = 0, ne = 0, pin = -1;
+	cpu_set_t set;
+	int mlist[MAX_LIST], tlist[MAX_LIST], llist[MAX_LIST], elist[MAX_LIST];
 
-	fprintf(stderr, "%s: bch decoder benchmark\n", argv[0]);
+	fprintf(stderr, "%s: bch encoder/decoder benchmark\n", argv[0]);
 	fprintf(stderr, "%s-endian, type sizes: int=%d long=%d longlong=%d\n",
 		(htonl(0x01020304) == 0x01020304)? "big" : "little",
 		(int)sizeof(int), (int)sizeof(long), (int)sizeof(long long));
-
-	if (argc != 4) {
-		fprintf(stderr, "Usage: %s m t <sec>\n", argv[0]);
-		exit(1);
+	fprintf(stderr, "compiler: %s\ncflags: %s\n", __VERSION__,
+		BENCH_CFLAGS);
+
+	while ((c = getopt(argc, argv, "f:l:e:LC:c:")) != -1) {
+		switch (c) {
+		case 'f':
+			if (!strcmp(optarg, "text"))
+				format = FMT_TEXT;
+			else if (!strcmp(optarg, "csv"))
+				format = FMT_CSV;
+			else if (!strcmp(optarg, "json"))
+				format = FMT_JSON;
+			else
+				usage(argv[0]);
+			break;
+		case 'l':
+			nl = parse_list(optarg, llist, MAX_LIST);
+			break;
+		case 'e':
+			ne = parse_list(optarg, elist, MAX_LIST);
+			break;
+		case 'L':
+			latency = 1;
+			break;
+		case 'C':
+			if (!strcmp(optarg, "raw"))
+				raw_clock = 1;
+			else if (strcmp(optarg, "cycles"))
+				usage(argv[0]);
+			break;
+		case 'c':
+			pin = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (argc-optind != 3)
+		usage(argv[0]);
+
+	nm = parse_list(argv[optind], mlist, MAX_LIST);
+	nt = parse_list(argv[optind+1], tlist, MAX_LIST);
+	ms = atoi(argv[optind+2])*1000;
+	if ((nm <= 0) || (nt <= 0) || (nl < 0) || (ne < 0) || (ms <= 0))
+		usage(argv[0]);
+
+	if (latency) {
+		/* pin to a single cpu, so that cycle counts are consistent */
+		if (pin < 0)
+			pin = sched_getcpu();
+		CPU_ZERO(&set);
+		CPU_SET(pin, &set);
+		if (sched_setaffinity(0, sizeof(set), &set))
+			perror("sched_setaffinity");
+		else
+			fprintf(stderr, "pinned to cpu %d\n", pin);
+		calibrate_clock();
 	}
-	m = atoi(argv[1]);
-	t = atoi(argv[2]);
-	ms = atoi(argv[3])*1000;
-
-	nbits = (1 << (m-1))+m*t;
-	assert(nbits < (1 << m));
 
-	bch_test_bench(m, t, ms);
+	read_cpu_model();
+	print_begin();
+	for (i = 0; i < nm; i++) {
+		for (j = 0; j < nt; j++) {
+			bch_test_bench(mlist[i], tlist[j], ms, llist, nl,
+				       elist, ne);
+		}
+	}
+	print_end();
 
 	return 0;
 }
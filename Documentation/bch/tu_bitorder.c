@@ -0,0 +1,289 @@
+/*
+ * BCH library tests
+ *
+ * Bit order test: an LSB-first instance (BCH_OPT_LSB_FIRST) must produce the
+ * same ecc as an MSB-first instance processing data and ecc with bits reversed
+ * in each byte, and report error locations which directly designate flipped
+ * bits of LSB-first buffers. Encoding (aligned or not, incremental, ecc
+ * update), decoding (hard, batch, soft, from syndromes) and snapshots are
+ * checked with all usable encoder/decoder variants, with shared and private
+ * tables.
+ *
+ * Usage: ./tu_bitorder [m t [niter]]
+ *
+ * Default is a set of (m,t) pairs and 200 iterations.
+ *
+ * Copyright (C) 2011 Parrot S.A.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../../lib/bch.c"
+
+#define NITER 200
+
+static unsigned int niter = NITER;
+
+static inline unsigned int rev8(unsigned int x)
+{
+	return (x & ~7)|(7-(x & 7));
+}
+
+static void bitrev_buf(uint8_t *dst, const uint8_t *src, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		dst[i] = bitrev_bytes(src[i]);
+	}
+}
+
+/* pick nerr distinct codeword bit locations */
+static void random_errors(unsigned int *vec, int nerr, unsigned int nbits)
+{
+	int i, j, ok;
+
+	for (i = 0; i < nerr; i++) {
+		do {
+			vec[i] = lrand48() % nbits;
+			for (j = 0, ok = 1; j < i; j++) {
+				ok &= (vec[j] != vec[i]);
+			}
+		} while (!ok);
+	}
+}
+
+static void flip(uint8_t *buf, const unsigned int *vec, int nerr)
+{
+	int i;
+
+	for (i = 0; i < nerr; i++) {
+		buf[vec[i]/8] ^= 1 << (vec[i] & 7);
+	}
+}
+
+static int same_locations(const unsigned int *a, const unsigned int *b,
+			  int n)
+{
+	int i, j;
+
+	for (i = 0; i < n; i++) {
+		for (j = 0; (j < n) && (a[i] != b[j]); j++)
+			;
+		if (j == n)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * check one LSB-first codeword against the MSB-first reference: cw holds
+ * len data bytes followed by ecc, and is restored on return
+ */
+static void check_codeword(struct bch_control *msb, struct bch_control *lsb,
+			   uint8_t *cw, unsigned int len, int iter)
+{
+	const int t = lsb->t;
+	const unsigned int size = len+lsb->ecc_bytes;
+	const unsigned int nbits = 8*len+lsb->ecc_bits;
+	unsigned int vec[t+2], errloc[t+2], lrb[2];
+	unsigned int syn[2*t], rsyn[2*t];
+	uint8_t ref[size], rcw[size], buf[size+3], ecc[lsb->ecc_bytes];
+	const uint8_t *data[2], *recv_ecc[2];
+	int i, nerr, res[2];
+
+	/* aligned and unaligned encoding matches reversed MSB-first ecc */
+	memcpy(ref, cw, size);
+	bitrev_buf(rcw, cw, len);
+	memset(rcw+len, 0, lsb->ecc_bytes);
+	encode_bch(msb, rcw, len, rcw+len);
+	bitrev_buf(ecc, rcw+len, lsb->ecc_bytes);
+	assert(memcmp(ecc, cw+len, lsb->ecc_bytes) == 0);
+
+	memcpy(buf+(iter & 3), cw, len);
+	memset(ecc, 0, sizeof(ecc));
+	encode_bch(lsb, buf+(iter & 3), len, ecc);
+	assert(memcmp(ecc, cw+len, lsb->ecc_bytes) == 0);
+
+	/* incremental encoding */
+	i = lrand48() % (len+1);
+	memset(ecc, 0, sizeof(ecc));
+	encode_bch(lsb, cw, i, ecc);
+	encode_bch(lsb, cw+i, len-i, ecc);
+	assert(memcmp(ecc, cw+len, lsb->ecc_bytes) == 0);
+
+	/* ecc update after modifying a data byte */
+	i = lrand48() % len;
+	memcpy(ecc, cw+len, lsb->ecc_bytes);
+	buf[0] = cw[i];
+	buf[1] = cw[i]^(1+(lrand48() % 255));
+	assert(update_ecc_bch(lsb, ecc, len, i, &buf[0], &buf[1], 1) == 0);
+	cw[i] = buf[1];
+	memset(cw+len, 0, lsb->ecc_bytes);
+	encode_bch(lsb, cw, len, cw+len);
+	assert(memcmp(ecc, cw+len, lsb->ecc_bytes) == 0);
+	memcpy(cw, ref, size);
+
+	/* hard decoding locates LSB-first bits, in data and in ecc */
+	nerr = iter % (t+1);
+	random_errors(vec, nerr, nbits);
+	flip(cw, vec, nerr);
+	assert(decode_bch(lsb, cw, len, cw+len, NULL, NULL, errloc) == nerr);
+	assert(same_locations(vec, errloc, nerr));
+
+	/* syndromes do not depend on bit order */
+	bitrev_buf(rcw, cw, size);
+	assert(compute_syndromes_bch(lsb, cw, len, cw+len, syn) == 0);
+	assert(compute_syndromes_bch(msb, rcw, len, rcw+len, rsyn) == 0);
+	assert(memcmp(syn, rsyn, sizeof(syn)) == 0);
+	assert(decode_bch(lsb, NULL, len, NULL, NULL, syn, errloc) == nerr);
+	assert(same_locations(vec, errloc, nerr));
+
+	/* syndrome update after flipping one more bit */
+	if (nerr < t) {
+		memcpy(buf, cw, size);
+		random_errors(&vec[nerr], 1, nbits);
+		for (i = 0; i < nerr; i++) {
+			if (vec[i] == vec[nerr])
+				break;
+		}
+		if (i == nerr) {
+			flip(buf, &vec[nerr], 1);
+			assert(update_syndromes_bch(lsb, syn, len, cw, buf,
+						    cw+len, buf+len) == 1);
+			assert(decode_bch(lsb, NULL, len, NULL, NULL, syn,
+					  errloc) == nerr+1);
+			assert(same_locations(vec, errloc, nerr+1));
+		}
+	}
+
+	/* batch decoding of the corrupted and reference codewords */
+	data[0] = cw;
+	data[1] = ref;
+	recv_ecc[0] = cw+len;
+	recv_ecc[1] = ref+len;
+	assert(decode_bch_batch(lsb, 2, data, len, recv_ecc, errloc, res) == 0);
+	assert((res[0] == nerr) && (res[1] == 0));
+	assert(same_locations(vec, errloc, nerr));
+
+	/* correction restores the LSB-first codeword */
+	assert(correct_bch(lsb, cw, len, cw+len) == nerr);
+	assert(memcmp(cw, ref, size) == 0);
+
+	/* soft decoding of t+1 errors matches reversed MSB-first decoding */
+	random_errors(vec, t+1, nbits);
+	flip(cw, vec, t+1);
+	bitrev_buf(rcw, cw, size);
+	lrb[0] = vec[t];
+	lrb[1] = vec[0];
+	nerr = decode_bch_soft(lsb, cw, len, cw+len, lrb, 2, errloc);
+	lrb[0] = rev8(lrb[0]);
+	lrb[1] = rev8(lrb[1]);
+	assert(decode_bch_soft(msb, rcw, len, rcw+len, lrb, 2, vec) == nerr);
+	for (i = 0; i < nerr; i++) {
+		vec[i] = rev8(vec[i]);
+	}
+	assert(same_locations(vec, errloc, nerr));
+	memcpy(cw, ref, size);
+}
+
+static void test_bitorder(int m, int t, unsigned int flags)
+{
+	int iter, size, nsnap;
+	unsigned int len;
+	struct bch_opts opts = {.flags = flags};
+	struct bch_control *msb, *lsb, *snap;
+	const struct bch_spec *const *spec;
+	uint8_t *cw;
+	void *buf;
+
+	msb = init_bch_opts(m, t, 0, &opts);
+	opts.flags |= BCH_OPT_LSB_FIRST;
+	lsb = init_bch_opts(m, t, 0, &opts);
+	assert(msb && lsb);
+	assert(bch_set_kernel(msb, "generic") == 0);
+
+	/* field tables are shared, encoding tables are not */
+	assert(lsb->mod8_tab != msb->mod8_tab);
+	assert(lsb->ecc_bits == msb->ecc_bits);
+
+	len = (1 << (m-1))/8;
+	size = len+lsb->ecc_bytes;
+	cw = malloc(size);
+	assert(cw);
+	srand48(m*t);
+
+	/* generic code first, then all usable variants */
+	spec = bch_spec_list;
+	bch_set_kernel(lsb, "generic");
+	do {
+		fprintf(stderr, "bitorder:m=%d:t=%d:tables=%s:kernel=%s\n", m,
+			t, (flags & BCH_OPT_PRIVATE_TABLES) ? "private" :
+			"shared", bch_get_kernel(lsb));
+		for (iter = 0; iter < (int)niter; iter++) {
+			for (size = 0; size < (int)len; size++) {
+				cw[size] = lrand48();
+			}
+			memset(cw+len, 0, lsb->ecc_bytes);
+			encode_bch(lsb, cw, len, cw+len);
+			check_codeword(msb, lsb, cw, len, iter);
+		}
+		while (*spec && bch_set_kernel(lsb, (*spec)->name))
+			spec++;
+	} while (*spec++);
+
+	/* snapshots keep bit order */
+	nsnap = save_bch_snapshot(lsb, NULL, 0);
+	buf = malloc(nsnap);
+	assert(buf);
+	assert(save_bch_snapshot(lsb, buf, nsnap) == nsnap);
+	snap = init_bch_snapshot(buf, nsnap);
+	assert(snap);
+	assert(bch_set_kernel(snap, "generic") == 0);
+	check_codeword(msb, snap, cw, len, 1);
+	free_bch(snap);
+	free(buf);
+
+	free(cw);
+	free_bch(lsb);
+	free_bch(msb);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int i, flags;
+	static const int params[][2] = {
+		{5, 2}, {8, 4}, {10, 3}, {13, 4}, {13, 8}, {14, 8}, {15, 16},
+	};
+
+	if (argc > 3)
+		niter = atoi(argv[3]);
+
+	for (flags = 0; flags <= BCH_OPT_PRIVATE_TABLES;
+	     flags += BCH_OPT_PRIVATE_TABLES) {
+		if (argc > 2) {
+			test_bitorder(atoi(argv[1]), atoi(argv[2]), flags);
+			continue;
+		}
+		for (i = 0; i < ARRAY_SIZE(params); i++) {
+			test_bitorder(params[i][0], params[i][1], flags);
+		}
+	}
+	return 0;
+}
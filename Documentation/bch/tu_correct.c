@@ -1,21 +1,53 @@
 /*
  * BCH library tests
  *
- * Error correction verification tool, with 3 modes:
- * - full: test all possible error vectors
+ * Error correction verification tool, with 6 modes:
+ * - full: test all possible error vectors, decoded from syndromes updated
+ *   incrementally along the enumeration
  * - rand: test random vectors for a given number of iterations
  * - burst: test all contiguous error bursts vectors
+ * - batch: test random vectors on pages of sectors, using decode_bch_batch()
+ * - soft: test random vectors of t+1..t+3 errors with decode_bch_soft(),
+ *   providing locations of extra errors among least reliable bits
+ * - retry: test random read-retry sequences, updating syndromes between
+ *   successive reads with update_syndromes_bch()
  *
  * Usage:
+ * ./tu_correct [-s i/n] [-j jobs] [-k file] mode tmax [m] [niter]
+ * with mode one of:
  * ./tu_correct full tmax [m]
  * OR
  * ./tu_correct rand tmax [m] [niter]
  * OR
  * ./tu_correct burst tmax [m]
+ * OR
+ * ./tu_correct batch tmax [m] [niter]
+ * OR
+ * ./tu_correct soft tmax [m] [niter]
+ * OR
+ * ./tu_correct retry tmax [m] [niter]
+ * OR
+ * ./tu_correct merge file...
  *
  * Error correction is tested from t=2 up to t=tmax.
  * If no 'm' value provided, all m values in range [7;15] are tested.
  *
+ * Tests are split into units of work (first error position in full mode,
+ * blocks of RAND_BLOCK iterations in rand mode, one value of m, t and error
+ * count in burst mode, one value of m in other modes), dealt round-robin to
+ * shards:
+ * -s i/n: only run units of shard i out of n, e.g. on different hosts
+ * -j jobs: fork jobs processes, each running its own shard (0 = all cpus),
+ *  and merge their results; combined with -s, shard i/n is split further
+ * -k file: save progress of the shard into file (file.0, file.1, ... with
+ *  -j) at most once per second, between test units, and resume from there if
+ *  file exists
+ *
+ * Mode 'merge' sums results of completed shards from their checkpoint files,
+ * and fails if some of them were not completed, if shards are missing or
+ * overlap, or if checkpoints come from different test arguments; with -s i/n,
+ * shards must cover shard i/n instead of all units.
+ *
  * Copyright (C) 2011 Parrot S.A.
  *
  * This program is free software; you can redistribute it and/or
@@ -37,10 +69,15 @@
 #include <unistd.h>
 #include <assert.h>
 #include <inttypes.h>
+#include <time.h>
+#include <sys/wait.h>
 
 struct gf_poly;
 
 #define RAND_ITER 1000000
+#define RAND_BLOCK 100000
+#define BATCH_SECTORS 16
+#define SOFT_MAX_LRB 12
 
 #define MAX_TESTS 15000000000ull
 //#define DEBUG 1
@@ -71,6 +108,13 @@ char * gf_poly_dump(const struct gf_poly *f, char *buf)
 	return buf;
 }
 
+/* sharding state: units of work below ckpt_unit were done in a previous run */
+static unsigned int shard_id, shard_cnt = 1;
+static uint64_t unit_next, ckpt_unit, tested;
+static const char *ckpt_path;
+static char ckpt_args[256];
+static time_t ckpt_time;
+
 static inline void update_pct(uint64_t tot)
 {
 	int pct;
@@ -78,6 +122,12 @@ static inline void update_pct(uint64_t tot)
 	static uint64_t iter = 0;
 	static uint64_t total = 1;
 
+	if (!tot)
+		tested++;
+	/* progress of interleaved shards is meaningless */
+	if (shard_cnt > 1)
+		return;
+
 	if (tot) {
 		iter = 0;
 		total = tot;
@@ -95,6 +145,83 @@ static inline void update_pct(uint64_t tot)
 	}
 }
 
+/*
+ * checkpoint file format:
+ * tu_correct <shard>/<count> <arguments>
+ * unit=<next unit> tested=<tested vectors> done=<0|1>
+ */
+static void ckpt_save(int done)
+{
+	int ret;
+	FILE *fp;
+	char tmp[strlen(ckpt_path)+5];
+
+	sprintf(tmp, "%s.tmp", ckpt_path);
+	fp = fopen(tmp, "w");
+	assert(fp);
+	fprintf(fp, "tu_correct %u/%u%s\nunit=%" PRIu64 " tested=%" PRIu64
+		" done=%d\n", shard_id, shard_cnt, ckpt_args, ckpt_unit, tested,
+		done);
+	ret = fclose(fp);
+	assert(ret == 0);
+	ret = rename(tmp, ckpt_path);
+	assert(ret == 0);
+	ckpt_time = time(NULL);
+}
+
+static int ckpt_read(const char *path, char *hdr, size_t size,
+		     uint64_t *unit, uint64_t *count, int *done)
+{
+	int ret;
+	FILE *fp = fopen(path, "r");
+
+	if (!fp)
+		return -1;
+	ret = (fgets(hdr, size, fp) && (fscanf(fp, "unit=%" SCNu64 " tested=%"
+						SCNu64 " done=%d", unit, count,
+						done) == 3)) ? 0 : -1;
+	fclose(fp);
+	hdr[strcspn(hdr, "\n")] = '\0';
+	return ret;
+}
+
+static void ckpt_load(void)
+{
+	int done;
+	char hdr[sizeof(ckpt_args)+32], exp[sizeof(hdr)];
+
+	if (ckpt_read(ckpt_path, hdr, sizeof(hdr), &ckpt_unit, &tested,
+		      &done) < 0) {
+		ckpt_unit = tested = 0;
+		return;
+	}
+	snprintf(exp, sizeof(exp), "tu_correct %u/%u%s", shard_id, shard_cnt,
+		 ckpt_args);
+	if (strcmp(hdr, exp) != 0) {
+		fprintf(stderr, "%s: checkpoint of another run (%s)\n",
+			ckpt_path, hdr);
+		exit(1);
+	}
+	fprintf(stderr, "%s: resuming at unit %" PRIu64 " (%" PRIu64
+		" vectors checked)\n", ckpt_path, ckpt_unit, tested);
+}
+
+/* return 1 if next unit of work belongs to this shard and is not done yet */
+static int shard_begin(void)
+{
+	uint64_t unit = unit_next++;
+
+	return ((unit % shard_cnt) == shard_id) && (unit >= ckpt_unit);
+}
+
+/* units are processed in order: all previous units of this shard are done */
+static void shard_end(void)
+{
+	ckpt_unit = unit_next;
+	if (ckpt_path && (time(NULL) != ckpt_time))
+		ckpt_save(0);
+}
+
 static void encode(struct bch_control *bch, uint8_t *data, int len,
 		   uint8_t *ecc)
 {
@@ -255,12 +382,48 @@ static void check_vector(struct bch_control *bch, uint8_t *data, int len,
 	update_pct(0);
 }
 
+/*
+ * check decode_bch_fix() and correct_bch() against the known error vector
+ */
+static void check_fix(struct bch_control *bch, uint8_t *data, uint8_t *ref,
+		      int len, const unsigned int *vec, int vecsize)
+{
+	int i, j, ret, nfix, nbits = 0;
+	struct bch_fix fix[bch->t];
+	uint8_t *read_ecc = (data+len);
+
+	corrupt_data(data, vec, vecsize);
+	nfix = decode_bch_fix(bch, data, len, read_ecc, NULL, NULL, fix);
+	assert((nfix > 0) && (nfix <= vecsize));
+
+	for (i = 0; i < nfix; i++) {
+		/* entries must be sorted and unique */
+		assert((i == 0) || (fix[i].offset > fix[i-1].offset));
+		assert(fix[i].mask);
+		nbits += __builtin_popcount(fix[i].mask);
+	}
+	assert(nbits == vecsize);
+	for (i = 0; i < vecsize; i++) {
+		for (j = 0; j < nfix; j++) {
+			if (fix[j].offset == vec[i]/8)
+				break;
+		}
+		assert(j < nfix);
+		assert(fix[j].mask & (1 << (vec[i] & 7)));
+	}
+
+	ret = correct_bch(bch, data, len, read_ecc);
+	assert(ret == vecsize);
+	assert(memcmp(data, ref, len+bch->ecc_bytes) == 0);
+}
+
 static void bch_test_errors_random(int m, int t, int iter)
 {
-	int i, len, vecsize;
+	int i, blk, n, len, vecsize;
 	struct bch_control *bch;
 	unsigned int vec[t];
-	uint8_t *data;
+	unsigned short seed[3];
+	uint8_t *data, *ref;
 
 	fprintf(stderr,"m=%d: checking %d random %d error vectors: ",m, iter,t);
 	update_pct(iter);
@@ -281,29 +444,67 @@ static void bch_test_errors_random(int m, int t, int iter)
 		data[i] = lrand48() & 0xff;
 	}
 	encode(bch, data, len, data+len);
-
-	while (iter-- > 0) {
-		vecsize = (lrand48() % t)+1;
-		generate_random_vector(bch, len, vec, vecsize);
-		check_vector(bch, data, len, vec, vecsize);
+	ref = malloc(len+bch->ecc_bytes);
+	assert(ref);
+	memcpy(ref, data, len+bch->ecc_bytes);
+
+	for (blk = 0; blk < iter; blk += RAND_BLOCK) {
+		if (!shard_begin())
+			continue;
+		/* each block is reproducible whichever shard runs it */
+		seed[0] = blk;
+		seed[1] = blk >> 16;
+		seed[2] = m;
+		seed48(seed);
+		n = (iter-blk < RAND_BLOCK) ? iter-blk : RAND_BLOCK;
+		while (n-- > 0) {
+			vecsize = (lrand48() % t)+1;
+			generate_random_vector(bch, len, vec, vecsize);
+			check_vector(bch, data, len, vec, vecsize);
+			check_fix(bch, data, ref, len, vec, vecsize);
+		}
+		shard_end();
 	}
 	fprintf(stderr,"\n");
+	free(ref);
 	free(data);
 	free_bch(bch);
 }
 
+/*
+ * Exhaustive tests: syndromes are linear, hence syndromes of an error vector
+ * are the sum of syndromes of its error positions. These are computed once,
+ * and accumulated along the enumeration, such that syn[k*2t..] holds the sum
+ * for the first k error positions; each vector then costs a single 2t-word
+ * xor instead of an encoding of the whole codeword, and is decoded from its
+ * syndromes. The first vector of each unit of work is still checked through
+ * the full decoding path, as a cross-check.
+ */
 static void bch_test_errors_full_k(struct bch_control *bch, uint8_t *data,
 				   int len, int k, unsigned int *vec,
-				   int nerrors)
+				   int nerrors, const unsigned int *pos_syn,
+				   unsigned int *syn, int *full)
 {
+	const unsigned int nsyn = 2*bch->t;
 	unsigned int i, j, nbits = 8*len+bch->ecc_bits;
+	unsigned int errloc[bch->t];
+	int nerr;
 
 	if (k == nerrors) {
 		/* make sure we stay in linear interval */
 		for (i = 0; i < (unsigned int)nerrors; i++) {
 			vec[i] = rev8(vec[i]);
 		}
-		check_vector(bch, data, len, vec, nerrors);
+		if (*full) {
+			check_vector(bch, data, len, vec, nerrors);
+			*full = 0;
+		} else {
+			nerr = decode_bch(bch, NULL, len, NULL, NULL,
+					  &syn[k*nsyn], errloc);
+			assert(nerr >= 0);
+			compare_vectors(vec, nerrors, errloc, nerr);
+			update_pct(0);
+		}
 		/* make sure we stay in linear interval */
 		for (i = 0; i < (unsigned int)nerrors; i++) {
 			vec[i] = rev8(vec[i]);
@@ -312,18 +513,29 @@ static void bch_test_errors_full_k(struct bch_control *bch, uint8_t *data,
 	else {
 		j = (k > 0)? vec[k-1]+1 : 0;
 		for (i = j; i < nbits-(nerrors-k-1); i++) {
+			/* units of work are the positions of the first error */
+			if ((k == 0) && !shard_begin())
+				continue;
 			vec[k] = i;
-			bch_test_errors_full_k(bch, data, len,k+1,vec, nerrors);
+			for (j = 0; j < nsyn; j++) {
+				syn[(k+1)*nsyn+j] = syn[k*nsyn+j]^
+					pos_syn[i*nsyn+j];
+			}
+			*full |= (k == 0);
+			bch_test_errors_full_k(bch, data, len, k+1, vec,
+					       nerrors, pos_syn, syn, full);
+			if (k == 0)
+				shard_end();
 		}
 	}
 }
 
 static void bch_test_errors_full(int m, int t, int nerrors)
 {
-	int i, len;
+	int i, len, nbits, full = 0;
 	uint64_t iter, den;
 	struct bch_control *bch;
-	unsigned int vec[t];
+	unsigned int vec[t], *pos_syn, *syn;
 	uint8_t *data;
 
 	assert(nerrors <= t);
@@ -363,9 +575,22 @@ static void bch_test_errors_full(int m, int t, int nerrors)
 	}
 	encode(bch, data, len, data+len);
 
-	bch_test_errors_full_k(bch, data, len, 0, vec, nerrors);
+	/* syndromes of each error position, in enumeration order */
+	nbits = 8*len+bch->ecc_bits;
+	pos_syn = calloc(nbits, 2*t*sizeof(*pos_syn));
+	syn = calloc(nerrors+1, 2*t*sizeof(*syn));
+	assert(pos_syn && syn);
+	for (i = 0; i < nbits; i++) {
+		update_syndromes(bch, &pos_syn[i*2*t],
+				 errloc_to_exp(bch, nbits, rev8(i)));
+	}
+
+	bch_test_errors_full_k(bch, data, len, 0, vec, nerrors, pos_syn, syn,
+			       &full);
 
 	fprintf(stderr,"\n");
+	free(syn);
+	free(pos_syn);
 	free(data);
 	free_bch(bch);
 }
@@ -415,20 +640,443 @@ static void bch_test_errors_bursts(int m, int t, int nerrors)
 	free_bch(bch);
 }
 
+static void bch_test_errors_batch(int m, int t, int iter)
+{
+	int i, s, len, nfail, vecsize[BATCH_SECTORS], nerr[BATCH_SECTORS];
+	struct bch_control *bch;
+	unsigned int vec[BATCH_SECTORS][t], errloc[BATCH_SECTORS*t];
+	uint8_t *data[BATCH_SECTORS], *ecc[BATCH_SECTORS];
+
+	fprintf(stderr,"m=%d: checking %d random pages of %d sectors: ", m,
+		iter, BATCH_SECTORS);
+	update_pct(iter);
+
+	bch = init_bch(m, t, 0);
+	assert(bch);
+
+	srand48(m);
+	len = (1 << (m-1))/8;
+
+	for (s = 0; s < BATCH_SECTORS; s++) {
+		data[s] = malloc(len+bch->ecc_bytes);
+		assert(data[s]);
+		for (i = 0; i < len; i++) {
+			data[s][i] = lrand48() & 0xff;
+		}
+		ecc[s] = data[s]+len;
+		encode(bch, data[s], len, ecc[s]);
+	}
+	nfail = decode_bch_batch(bch, BATCH_SECTORS,
+				 (const uint8_t * const *)data, 8*len+1,
+				 (const uint8_t * const *)ecc, errloc, nerr);
+	assert(nfail == -EINVAL);
+
+	while (iter-- > 0) {
+		/* leave about half of the sectors without errors */
+		for (s = 0; s < BATCH_SECTORS; s++) {
+			vecsize[s] = (lrand48() & 1) ? (lrand48() % t)+1 : 0;
+			generate_random_vector(bch, len, vec[s], vecsize[s]);
+			corrupt_data(data[s], vec[s], vecsize[s]);
+		}
+		nfail = decode_bch_batch(bch, BATCH_SECTORS,
+					 (const uint8_t * const *)data, len,
+					 (const uint8_t * const *)ecc, errloc,
+					 nerr);
+		assert(nfail == 0);
+		for (s = 0; s < BATCH_SECTORS; s++) {
+			corrupt_data(data[s], vec[s], vecsize[s]);
+			assert(nerr[s] >= 0);
+			compare_vectors(vec[s], vecsize[s], errloc+s*t,
+					nerr[s]);
+		}
+		update_pct(0);
+	}
+
+	/* uncorrectable sectors must not prevent decoding other sectors */
+	for (s = 0; s < BATCH_SECTORS; s += 2) {
+		vecsize[s] = t+1;
+		generate_random_vector(bch, len, vec[s], vecsize[s]);
+		corrupt_data(data[s], vec[s], vecsize[s]);
+	}
+	nfail = decode_bch_batch(bch, BATCH_SECTORS,
+				 (const uint8_t * const *)data, len,
+				 (const uint8_t * const *)ecc, errloc, nerr);
+	assert((nfail >= 0) && (nfail <= BATCH_SECTORS/2));
+	for (s = 0; s < BATCH_SECTORS; s++) {
+		if (s & 1)
+			assert(nerr[s] == 0);
+		else
+			corrupt_data(data[s], vec[s], vecsize[s]);
+	}
+
+	fprintf(stderr,"\n");
+	for (s = 0; s < BATCH_SECTORS; s++) {
+		free(data[s]);
+	}
+	free_bch(bch);
+}
+
+static void bch_test_errors_soft(int m, int t, int iter)
+{
+	int i, j, k, len, vecsize, nlrb, nerr, exact = 0;
+	struct bch_control *bch;
+	unsigned int vec[t+3], lrb[SOFT_MAX_LRB], errloc[t+SOFT_MAX_LRB];
+	unsigned int tmp[SOFT_MAX_LRB+t+3];
+	uint8_t *data, *ref;
+
+	fprintf(stderr,"m=%d: checking %d soft decoding vectors: ", m, iter);
+	update_pct(iter);
+
+	bch = init_bch(m, t, 0);
+	assert(bch);
+
+	srand48(m);
+	len = (1 << (m-1))/8;
+
+	data = malloc(len+bch->ecc_bytes);
+	ref = malloc(len+bch->ecc_bytes);
+	assert(data && ref);
+	for (i = 0; i < len; i++) {
+		data[i] = lrand48() & 0xff;
+	}
+	encode(bch, data, len, data+len);
+	memcpy(ref, data, len+bch->ecc_bytes);
+
+	for (k = 0; k < iter; k++) {
+		vecsize = t+(lrand48() % 4);
+		nlrb = 4+(lrand48() % (SOFT_MAX_LRB-3));
+		if (nlrb < vecsize-t)
+			nlrb = vecsize-t;
+		/*
+		 * pick nlrb decoys and vecsize errors, the last (vecsize-t)
+		 * errors are always part of least reliable bits
+		 */
+		generate_random_vector(bch, len, tmp, nlrb+vecsize);
+		memcpy(vec, tmp+nlrb, vecsize*sizeof(*vec));
+		for (i = 0; i < nlrb; i++) {
+			lrb[i] = (i < vecsize-t) ? vec[t+i] :
+				((lrand48() & 1) ? vec[lrand48() % t] : tmp[i]);
+			for (j = 0; j < i; j++) {
+				if (lrb[j] == lrb[i]) {
+					lrb[i] = tmp[i];
+					break;
+				}
+			}
+		}
+		/* shuffle reliability order */
+		for (i = nlrb-1; i > 0; i--) {
+			j = lrand48() % (i+1);
+			tmp[0] = lrb[i];
+			lrb[i] = lrb[j];
+			lrb[j] = tmp[0];
+		}
+
+		corrupt_data(data, vec, vecsize);
+		nerr = decode_bch_soft(bch, data, len, data+len, lrb, nlrb,
+				       errloc);
+		assert((nerr >= 0) && (nerr <= vecsize));
+		if (vecsize <= t)
+			compare_vectors(vec, vecsize, errloc, nerr);
+
+		/* corrected word must be a codeword */
+		corrupt_data(data, errloc, nerr);
+		nerr = decode_bch(bch, data, len, data+len, NULL, NULL,
+				  errloc);
+		assert(nerr == 0);
+		if (memcmp(data, ref, len+bch->ecc_bytes) == 0)
+			exact++;
+		memcpy(data, ref, len+bch->ecc_bytes);
+		update_pct(0);
+	}
+	/* miscorrections are expected beyond t errors, for small values of m */
+	fprintf(stderr," (%d exact)\n", exact);
+
+	free(ref);
+	free(data);
+	free_bch(bch);
+}
+
+static void bch_test_errors_retry(int m, int t, int iter)
+{
+	int i, k, len, vecsize, nerr, nerr2, nflips;
+	struct bch_control *bch;
+	unsigned int vec[2*t+4], errloc[t], errloc2[t], syn[2*t], syn2[2*t];
+	uint8_t *data, *prev, *ref;
+
+	fprintf(stderr,"m=%d: checking %d read-retry sequences: ", m, iter);
+	update_pct(iter);
+
+	bch = init_bch(m, t, 0);
+	assert(bch);
+
+	srand48(m);
+	len = (1 << (m-1))/8;
+
+	data = malloc(len+bch->ecc_bytes);
+	prev = malloc(len+bch->ecc_bytes);
+	ref = malloc(len+bch->ecc_bytes);
+	assert(data && prev && ref);
+	for (i = 0; i < len; i++) {
+		data[i] = lrand48() & 0xff;
+	}
+	encode(bch, data, len, data+len);
+	memcpy(ref, data, len+bch->ecc_bytes);
+
+	/* invalid length or buffers */
+	i = update_syndromes_bch(bch, syn, (bch->n+1)/8, prev, data, NULL,
+				 NULL);
+	assert(i == -EINVAL);
+	i = update_syndromes_bch(bch, syn, len, NULL, data, NULL, NULL);
+	assert(i == -EINVAL);
+
+	while (iter-- > 0) {
+		/* first read with up to 2t errors */
+		vecsize = (lrand48() % (2*t))+1;
+		generate_random_vector(bch, len, vec, vecsize);
+		corrupt_data(data, vec, vecsize);
+		i = compute_syndromes_bch(bch, data, len, data+len, syn);
+		assert(i == 0);
+
+		/* successive reads flip a few bits of the previous read */
+		for (k = 0; k < 4; k++) {
+			memcpy(prev, data, len+bch->ecc_bytes);
+			nflips = (lrand48() % 4)+1;
+			generate_random_vector(bch, len, vec+vecsize, nflips);
+			corrupt_data(data, vec+vecsize, nflips);
+
+			i = update_syndromes_bch(bch, syn, len, prev, data,
+						 prev+len, data+len);
+			assert(i == nflips);
+
+			/* compare with syndromes computed from scratch */
+			i = compute_syndromes_bch(bch, data, len, data+len,
+						  syn2);
+			assert(i == 0);
+			assert(memcmp(syn, syn2, sizeof(syn)) == 0);
+
+			nerr = decode_bch(bch, NULL, len, NULL, NULL, syn,
+					  errloc);
+			nerr2 = decode_bch(bch, data, len, data+len, NULL, NULL,
+					   errloc2);
+			assert(nerr == nerr2);
+			if (nerr > 0)
+				compare_vectors(errloc2, nerr2, errloc, nerr);
+		}
+		/* restore original codeword */
+		memcpy(data, ref, len+bch->ecc_bytes);
+		update_pct(0);
+	}
+	fprintf(stderr,"\n");
+	free(ref);
+	free(prev);
+	free(data);
+	free_bch(bch);
+}
+
+static uint64_t gcd64(uint64_t a, uint64_t b)
+{
+	uint64_t r;
+
+	while (b) {
+		r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+/*
+ * check that shards i/n cover each unit of shard shard_id/shard_cnt exactly
+ * once: shards i1/n1 and i2/n2 share units if and only if i1 = i2 mod
+ * gcd(n1, n2); disjoint subsets of shard s/c cover it if and only if the sum
+ * of their 1/n is 1/c
+ */
+static int check_shards(int nfiles, char * const files[],
+			const unsigned int *id, const unsigned int *cnt)
+{
+	int i, j;
+	uint64_t g, lcm = shard_cnt, sum = 0;
+
+	for (i = 0; i < nfiles; i++) {
+		if ((cnt[i] % shard_cnt) || ((id[i] % shard_cnt) != shard_id)) {
+			fprintf(stderr, "%s: shard %u/%u is not part of shard "
+				"%u/%u\n", files[i], id[i], cnt[i], shard_id,
+				shard_cnt);
+			return -1;
+		}
+		for (j = 0; j < i; j++) {
+			g = gcd64(cnt[i], cnt[j]);
+			if ((id[i] % g) == (id[j] % g)) {
+				fprintf(stderr, "%s: shard %u/%u overlaps "
+					"shard %u/%u of %s\n", files[i],
+					id[i], cnt[i], id[j], cnt[j],
+					files[j]);
+				return -1;
+			}
+		}
+		lcm = lcm/gcd64(lcm, cnt[i])*cnt[i];
+		if (lcm > UINT32_MAX) {
+			fprintf(stderr, "too many shard counts to merge\n");
+			return -1;
+		}
+	}
+	for (i = 0; i < nfiles; i++) {
+		sum += lcm/cnt[i];
+	}
+	if (sum != lcm/shard_cnt) {
+		fprintf(stderr, "missing shards: %" PRIu64 "/%" PRIu64
+			" of units covered\n", sum, lcm/shard_cnt);
+		return -1;
+	}
+	return 0;
+}
+
+static int merge_shards(int nfiles, char * const files[])
+{
+	int i, pos, done, incomplete = 0;
+	unsigned int id[nfiles], cnt[nfiles];
+	uint64_t unit, count, total = 0;
+	char hdr[sizeof(ckpt_args)+32], args[sizeof(hdr)];
+
+	for (i = 0; i < nfiles; i++) {
+		if ((ckpt_read(files[i], hdr, sizeof(hdr), &unit, &count,
+			       &done) < 0) ||
+		    (sscanf(hdr, "tu_correct %u/%u%n", &id[i], &cnt[i],
+			    &pos) != 2) || (id[i] >= cnt[i])) {
+			fprintf(stderr, "%s: cannot read checkpoint\n",
+				files[i]);
+			return 1;
+		}
+		/* all shards must belong to the same run */
+		if (i == 0) {
+			strcpy(args, hdr+pos);
+		} else if (strcmp(args, hdr+pos) != 0) {
+			fprintf(stderr, "%s: checkpoint of another run (%s)\n",
+				files[i], hdr);
+			return 1;
+		}
+		fprintf(stderr, "%s: %s: %" PRIu64 " vectors checked%s\n",
+			files[i], hdr, count, done ? "" : " (incomplete)");
+		total += count;
+		incomplete += !done;
+	}
+	if (check_shards(nfiles, files, id, cnt) < 0)
+		return 1;
+	fprintf(stderr, "merged %d shards: %" PRIu64 " vectors checked, "
+		"%d incomplete\n", nfiles, total, incomplete);
+	return incomplete ? 1 : 0;
+}
+
+/*
+ * fork one process per job, each running a shard, and return in children;
+ * the parent exits with the merged result, removing temporary checkpoints
+ */
+static void run_jobs(int jobs, const char *prefix, int tmp)
+{
+	int i, status, failed = 0;
+	pid_t pid;
+	char *files[jobs];
+
+	for (i = 0; i < jobs; i++) {
+		files[i] = malloc(strlen(prefix)+16);
+		assert(files[i]);
+		sprintf(files[i], "%s.%d", prefix, i);
+		pid = fork();
+		assert(pid >= 0);
+		if (pid == 0) {
+			/* job i of shard s/n runs shard s+i*n out of n*jobs */
+			shard_id += i*shard_cnt;
+			shard_cnt *= jobs;
+			ckpt_path = files[i];
+			return;
+		}
+	}
+	while (wait(&status) > 0) {
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			failed++;
+	}
+	if (failed)
+		fprintf(stderr, "%d of %d jobs failed\n", failed, jobs);
+	else
+		failed = merge_shards(jobs, files);
+	for (i = 0; tmp && (i < jobs); i++) {
+		unlink(files[i]);
+	}
+	exit(failed ? 1 : 0);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-s i/n] [-j jobs] [-k file] "
+		"[full tmax [m]]|"
+		"[rand tmax [m] [niter]]\n"
+		"[burst tmax [m]]|"
+		"[batch tmax [m] [niter]]|"
+		"[soft tmax [m] [niter]]|"
+		"[retry tmax [m] [niter]]|"
+		"[merge file...]\n",
+		prog);
+	exit(1);
+}
+
 int main(int argc, char *argv[])
 {
-	int m, t, k, nbits, tmax, m1 = 7, m2 = 15, niter = RAND_ITER;
-
-	if (argc < 3) {
-		fprintf(stderr, "Usage: %s "
-			"[full tmax [m]]|"
-			"[rand tmax [m] [niter]]\n"
-			"[burst tmax [m]]\n",
-			argv[0]);
-		exit(1);
+	int m, t, k, c, nbits, tmax, m1 = 7, m2 = 15, niter = RAND_ITER;
+	int jobs = -1;
+	size_t pos;
+	const char *prog = argv[0], *ckpt = NULL;
+	char prefix[32];
+
+	while ((c = getopt(argc, argv, "+s:j:k:")) != -1) {
+		switch (c) {
+		case 's':
+			if ((sscanf(optarg, "%u/%u", &shard_id,
+				    &shard_cnt) != 2) ||
+			    (shard_id >= shard_cnt))
+				usage(prog);
+			break;
+		case 'j':
+			jobs = atoi(optarg);
+			if (jobs == 0)
+				jobs = sysconf(_SC_NPROCESSORS_ONLN);
+			break;
+		case 'k':
+			ckpt = optarg;
+			break;
+		default:
+			usage(prog);
+		}
+	}
+	argc -= optind-1;
+	argv += optind-1;
+
+	if ((argc >= 3) && (strcmp(argv[1], "merge") == 0))
+		return merge_shards(argc-2, argv+2);
+
+	if (argc < 3)
+		usage(prog);
+	/* checkpoints are only valid for the same test arguments */
+	for (k = 1, pos = 0; (k < argc) && (pos < sizeof(ckpt_args)); k++) {
+		pos += snprintf(ckpt_args+pos, sizeof(ckpt_args)-pos, " %s",
+				argv[k]);
 	}
+
+	if (jobs > 0) {
+		/* without -k, results are merged through temporary files */
+		if (!ckpt) {
+			snprintf(prefix, sizeof(prefix), "/tmp/tu_correct.%d",
+				 (int)getpid());
+		}
+		run_jobs(jobs, ckpt ? ckpt : prefix, !ckpt);
+	}
+	else {
+		ckpt_path = ckpt;
+	}
+	if (ckpt_path)
+		ckpt_load();
+
 	tmax = atoi(argv[2]);
-	if (argc == 4) {
+	if (argc >= 4) {
 		m1 = m2 = atoi(argv[3]);
 	}
 
@@ -455,18 +1103,64 @@ int main(int argc, char *argv[])
 			}
 		}
 	}
+	else if (strcmp(argv[1], "batch") == 0) {
+		if (argc == 5) {
+			niter = atoi(argv[4]);
+		}
+		for (m = m1; m <= m2; m++) {
+			nbits = (1 << (m-1))+m*tmax;
+			if ((nbits < (1 << m)) && shard_begin()) {
+				bch_test_errors_batch(m, tmax, niter/16);
+				shard_end();
+			}
+		}
+	}
+	else if (strcmp(argv[1], "soft") == 0) {
+		if (argc == 5) {
+			niter = atoi(argv[4]);
+		}
+		for (m = m1; m <= m2; m++) {
+			nbits = (1 << (m-1))+m*tmax;
+			if ((nbits < (1 << m)) && shard_begin()) {
+				bch_test_errors_soft(m, tmax, niter);
+				shard_end();
+			}
+		}
+	}
+	else if (strcmp(argv[1], "retry") == 0) {
+		if (argc == 5) {
+			niter = atoi(argv[4]);
+		}
+		for (m = m1; m <= m2; m++) {
+			nbits = (1 << (m-1))+m*tmax;
+			if ((nbits < (1 << m)) && shard_begin()) {
+				bch_test_errors_retry(m, tmax, niter);
+				shard_end();
+			}
+		}
+	}
 	else if (strcmp(argv[1], "burst") == 0) {
 		for (m = m1; m <= m2; m++) {
 			for (t = 2; t <= tmax; t++) {
 				nbits = (1 << (m-1))+m*t;
 				if (nbits < (1 << m)) {
 					for (k = 2; k <= t; k++) {
+						if (!shard_begin())
+							continue;
 						bch_test_errors_bursts(m, t, k);
+						shard_end();
 					}
 				}
 			}
 		}
 	}
+	else {
+		usage(prog);
+	}
 
+	if (ckpt_path) {
+		ckpt_unit = unit_next;
+		ckpt_save(1);
+	}
 	return 0;
 }
@@ -0,0 +1,270 @@
+/*
+ * BCH library tests
+ *
+ * Multi-threaded decoding engine test: several submitter threads push jobs
+ * into an engine and reap completed jobs, which are checked against
+ * single-threaded decode_bch() results. Decoding throughput of the engine is
+ * then compared with inline decoding.
+ *
+ * Usage: ./tu_engine [nworkers [m t]]
+ *
+ * Default is 4 workers, m=13 and t=16.
+ *
+ * Copyright (C) 2011 Parrot S.A.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#include "../../lib/bch.c"
+#include "../../lib/bch_engine.c"
+
+#define NSECT		64
+#define NSUBMITTERS	3
+#define NJOBS		10000
+#define QDEPTH		16
+
+struct sector {
+	uint8_t        *data;
+	int             nerr;
+	unsigned int   *errloc;
+};
+
+struct submitter {
+	pthread_t               thread;
+	struct bch_engine      *engine;
+	struct bch_engine_job  *jobs;
+	int                     njobs;
+};
+
+static int m = 13, t = 16, len;
+static struct sector sect[NSECT];
+static unsigned long completed, total;
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e6+ts.tv_nsec/1e3;
+}
+
+static void check_job(struct bch_engine_job *job)
+{
+	int i;
+	struct sector *s = job->priv;
+
+	assert(job->nerr == s->nerr);
+	for (i = 0; i < job->nerr; i++) {
+		assert(job->errloc[i] == s->errloc[i]);
+	}
+}
+
+/*
+ * each submitter pushes jobs in chunks of up to QDEPTH jobs until the engine
+ * is full, and reaps jobs of any submitter until all jobs are completed
+ */
+static void *submitter_run(void *arg)
+{
+	struct submitter *sub = arg;
+	struct bch_engine_job *ptr[QDEPTH];
+	int i, n, next = 0;
+
+	while (__atomic_load_n(&completed, __ATOMIC_RELAXED) < total) {
+		for (i = 0; (i < QDEPTH) && (next+i < sub->njobs); i++) {
+			ptr[i] = &sub->jobs[next+i];
+		}
+		if (i) {
+			n = bch_engine_submit(sub->engine, ptr, i);
+			assert((n == -EAGAIN) || ((n > 0) && (n <= i)));
+			if (n > 0)
+				next += n;
+		}
+		n = bch_engine_reap(sub->engine, ptr, QDEPTH, 0);
+		for (i = 0; i < n; i++) {
+			check_job(ptr[i]);
+		}
+		__atomic_add_fetch(&completed, n, __ATOMIC_RELAXED);
+		if (!n)
+			usleep(20);
+	}
+	return NULL;
+}
+
+static void init_job(struct bch_engine_job *job, int i)
+{
+	struct sector *s = &sect[i % NSECT];
+
+	job->data = s->data;
+	job->ecc = s->data+len;
+	job->len = len;
+	job->priv = s;
+}
+
+static void test_engine(struct bch_control *bch, unsigned int nworkers)
+{
+	int i, j, ret, ncpus, cpus[nworkers];
+	struct bch_engine_opts opts;
+	struct bch_engine *engine;
+	struct submitter sub[NSUBMITTERS];
+	unsigned int *errloc;
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	for (i = 0; i < (int)nworkers; i++) {
+		cpus[i] = i % ncpus;
+	}
+	opts.nworkers = nworkers;
+	opts.ring_size = NSUBMITTERS*QDEPTH/2;
+	opts.batch = 4;
+	opts.cpus = cpus;
+
+	engine = bch_engine_create(m, t, 0, &opts);
+	assert(engine);
+
+	errloc = malloc(NSUBMITTERS*NJOBS*t*sizeof(*errloc));
+	assert(errloc);
+
+	completed = 0;
+	total = NSUBMITTERS*NJOBS;
+	for (i = 0; i < NSUBMITTERS; i++) {
+		sub[i].engine = engine;
+		sub[i].njobs = NJOBS;
+		sub[i].jobs = calloc(NJOBS, sizeof(*sub[i].jobs));
+		assert(sub[i].jobs);
+		for (j = 0; j < NJOBS; j++) {
+			init_job(&sub[i].jobs[j], i+j);
+			sub[i].jobs[j].errloc = errloc+(i*NJOBS+j)*t;
+		}
+		ret = pthread_create(&sub[i].thread, NULL, submitter_run,
+				     &sub[i]);
+		assert(ret == 0);
+	}
+	for (i = 0; i < NSUBMITTERS; i++) {
+		pthread_join(sub[i].thread, NULL);
+		free(sub[i].jobs);
+	}
+	assert(completed == total);
+	bch_engine_destroy(engine);
+	free(errloc);
+	fprintf(stderr, "engine:workers=%u: %lu jobs checked\n", nworkers,
+		total);
+}
+
+static void bench_engine(struct bch_control *bch, unsigned int nworkers)
+{
+	int i, n, submitted = 0, reaped = 0;
+	struct bch_engine_opts opts;
+	struct bch_engine *engine;
+	struct bch_engine_job *jobs, *ptr[NSECT];
+	unsigned int *errloc;
+	double t0, t1, t2;
+
+	jobs = calloc(NJOBS, sizeof(*jobs));
+	errloc = malloc(NJOBS*t*sizeof(*errloc));
+	assert(jobs && errloc);
+	for (i = 0; i < NJOBS; i++) {
+		init_job(&jobs[i], i);
+		jobs[i].errloc = errloc+i*t;
+	}
+
+	t0 = now_us();
+	for (i = 0; i < NJOBS; i++) {
+		jobs[i].nerr = decode_bch(bch, jobs[i].data, len, jobs[i].ecc,
+					  NULL, NULL, jobs[i].errloc);
+	}
+	t1 = now_us();
+
+	opts.nworkers = nworkers;
+	opts.ring_size = NSECT;
+	opts.batch = 4;
+	opts.cpus = NULL;
+	engine = bch_engine_create(m, t, 0, &opts);
+	assert(engine);
+
+	t2 = now_us();
+	while (reaped < NJOBS) {
+		for (i = 0; (i < NSECT) && (submitted+i < NJOBS); i++) {
+			ptr[i] = &jobs[submitted+i];
+		}
+		n = bch_engine_submit(engine, ptr, i);
+		if (n > 0)
+			submitted += n;
+		reaped += bch_engine_reap(engine, ptr, NSECT, 1);
+	}
+	t2 = now_us()-t2;
+	bch_engine_destroy(engine);
+
+	fprintf(stderr, "engine:m=%d:t=%d:workers=%u:inline=%.0f/s:"
+		"engine=%.0f/s\n", m, t, nworkers, NJOBS*1e6/(t1-t0),
+		NJOBS*1e6/t2);
+	free(errloc);
+	free(jobs);
+}
+
+int main(int argc, char *argv[])
+{
+	int i, j, nerr, nworkers = 4;
+	struct bch_control *bch;
+	unsigned int vec[64];
+
+	if (argc > 1)
+		nworkers = atoi(argv[1]);
+	if (argc > 3) {
+		m = atoi(argv[2]);
+		t = atoi(argv[3]);
+	}
+	assert((nworkers > 0) && (t <= 64));
+
+	bch = init_bch(m, t, 0);
+	assert(bch);
+	len = (1 << (m-1))/8;
+
+	/* prepare sectors with 0..t errors, or t+1 uncorrectable errors */
+	srand48(m);
+	for (i = 0; i < NSECT; i++) {
+		sect[i].data = calloc(len+bch->ecc_bytes, 1);
+		sect[i].errloc = calloc(t, sizeof(unsigned int));
+		assert(sect[i].data && sect[i].errloc);
+		for (j = 0; j < len; j++) {
+			sect[i].data[j] = lrand48() & 0xff;
+		}
+		encode_bch(bch, sect[i].data, len, sect[i].data+len);
+		nerr = (i < NSECT-4) ? lrand48() % (t+1) : t+1;
+		for (j = 0; j < nerr; j++) {
+			vec[j] = lrand48() % (8*len);
+			sect[i].data[vec[j]/8] ^= 1 << (vec[j] & 7);
+		}
+		sect[i].nerr = decode_bch(bch, sect[i].data, len,
+					  sect[i].data+len, NULL, NULL,
+					  sect[i].errloc);
+	}
+
+	test_engine(bch, 1);
+	test_engine(bch, nworkers);
+	bench_engine(bch, nworkers);
+
+	for (i = 0; i < NSECT; i++) {
+		free(sect[i].data);
+		free(sect[i].errloc);
+	}
+	free_bch(bch);
+	return 0;
+}
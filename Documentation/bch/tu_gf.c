@@ -5,7 +5,8 @@
  *
  * Usage: ./tu_gf [m]
  *
- * If m is not specified, test all m values in range [5;15].
+ * If m is not specified, test all m values in range [5;15]; values up to 20
+ * are supported but take much longer to check.
  *
  * Copyright (C) 2011 Parrot S.A.
  *
@@ -110,10 +111,10 @@ int main(int argc, char *argv[])
 {
 	/* default primitive polynomials */
 	const int min_m = 5;
-	const int max_m = 15;
+	const int max_m = BCH_MAX_M;
 	static const unsigned int prim_poly_tab[] = {
 		0x25, 0x43, 0x83, 0x11d, 0x211, 0x409, 0x805, 0x1053, 0x201b,
-		0x402b, 0x8003,
+		0x402b, 0x8003, 0x1002d, 0x20009, 0x40081, 0x80027, 0x100009,
 	};
 	struct bch_control *bch;
 	int m1 = 5, m2 = 15;
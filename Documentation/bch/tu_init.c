@@ -0,0 +1,213 @@
+/*
+ * BCH library tests
+ *
+ * Check lookup tables built by init_bch() against a bit-serial reference
+ * encoder, and benchmark init_bch() execution time.
+ *
+ * Usage: ./tu_init [m [t]]
+ *
+ * If m is not specified, test all m values in range [5;16]; if t is not
+ * specified, test values t=1,2,4,8,..,64 within code limits.
+ *
+ * Copyright (C) 2011 Parrot S.A.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#include "../../lib/bch.c"
+
+#define MIN_BENCH_US 200000
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000000.0+ts.tv_nsec/1000.0;
+}
+
+/*
+ * reference generator polynomial: product of (X+a^r) for all roots a^r,
+ * returned as an array of binary coefficients
+ */
+static unsigned int reference_genpoly(struct bch_control *bch, uint8_t *coef)
+{
+	unsigned int i, j, r, deg = 0;
+	uint8_t *roots;
+	unsigned int *g;
+
+	roots = calloc(bch->n+1, 1);
+	g = calloc(bch->m*bch->t+1, sizeof(*g));
+	assert(roots && g);
+
+	for (i = 0; i < bch->t; i++) {
+		for (j = 0, r = 2*i+1; j < bch->m; j++) {
+			roots[r] = 1;
+			r = mod_s(bch, 2*r);
+		}
+	}
+	g[0] = 1;
+	for (i = 0; i < bch->n; i++) {
+		if (roots[i]) {
+			r = bch->a_pow_tab[i];
+			g[deg+1] = 1;
+			for (j = deg; j > 0; j--)
+				g[j] = gf_mul(bch, g[j], r)^g[j-1];
+			g[0] = gf_mul(bch, g[0], r);
+			deg++;
+		}
+	}
+	for (i = 0; i <= deg; i++) {
+		assert(g[i] <= 1);
+		coef[i] = g[i];
+	}
+	free(g);
+	free(roots);
+	return deg;
+}
+
+/*
+ * bit-serial reference encoder: ecc = data(X).X^deg(g) mod g(X)
+ */
+static void reference_encode(const uint8_t *g, unsigned int deg,
+			     const uint8_t *data, unsigned int len,
+			     uint8_t *ecc)
+{
+	unsigned int i, j, fb;
+	uint8_t r[deg];
+
+	memset(r, 0, deg);
+	for (i = 0; i < 8*len; i++) {
+		/* r[deg-1] is the coefficient of highest degree */
+		fb = r[deg-1]^((data[i/8] >> (7-(i & 7))) & 1);
+		for (j = deg-1; j > 0; j--)
+			r[j] = r[j-1]^(fb & g[j]);
+		r[0] = fb & g[0];
+	}
+	memset(ecc, 0, (deg+7)/8);
+	for (i = 0; i < deg; i++) {
+		if (r[deg-1-i])
+			ecc[i/8] |= 0x80 >> (i & 7);
+	}
+}
+
+/* absolute trace of x over GF(2), computed independently of the library */
+static unsigned int trace(struct bch_control *bch, unsigned int x)
+{
+	unsigned int i, sum = 0;
+
+	for (i = 0; i < bch->m; i++) {
+		sum ^= x;
+		x = gf_sqr(bch, x);
+	}
+	assert(sum <= 1);
+	return sum;
+}
+
+static void check_tables(struct bch_control *bch)
+{
+	unsigned int i, deg, len, x, v, ak = 0;
+	uint8_t *data, g[bch->m*bch->t+1];
+	uint8_t ecc[bch->ecc_bytes], ref[bch->ecc_bytes];
+
+	/* check generator polynomial and remainder tables */
+	deg = reference_genpoly(bch, g);
+	assert(deg == bch->ecc_bits);
+
+	len = (bch->n-bch->ecc_bits)/8;
+	len = (len > 64) ? 64 : len;
+	data = malloc(len);
+	assert(data);
+	for (i = 0; i < len; i++)
+		data[i] = lrand48() & 0xff;
+
+	memset(ecc, 0, bch->ecc_bytes);
+	memset(ref, 0, bch->ecc_bytes);
+	encode_bch(bch, data, len, ecc);
+	reference_encode(g, deg, data, len, ref);
+	assert(!memcmp(ecc, ref, bch->ecc_bytes));
+	free(data);
+
+	/*
+	 * check degree 2 base: xi^2+xi = a^i if Tr(a^i) = 0, otherwise
+	 * xi^2+xi = a^i+a^k for a fixed a^k such that Tr(a^k) = 1
+	 */
+	for (i = 0; i < bch->m; i++) {
+		x = bch->xi_tab[i];
+		v = gf_sqr(bch, x)^x^bch->a_pow_tab[i];
+		if (trace(bch, bch->a_pow_tab[i]) == 0) {
+			assert(x && (v == 0));
+			continue;
+		}
+		assert(!ak || (v == ak));
+		ak = v;
+	}
+	assert(ak && (trace(bch, ak) == 1));
+}
+
+static void bch_test_init(int m, int t)
+{
+	int i, niter;
+	double d;
+	struct bch_control *bch;
+
+	bch = init_bch(m, t, 0);
+	assert(bch);
+	check_tables(bch);
+	free_bch(bch);
+
+	/* no other instance is alive, so that tables are rebuilt each time */
+	niter = 0;
+	d = now_us();
+	do {
+		for (i = 0; i < 10; i++) {
+			bch = init_bch(m, t, 0);
+			assert(bch);
+			free_bch(bch);
+		}
+		niter += 10;
+	} while (now_us()-d < MIN_BENCH_US);
+	d = now_us()-d;
+
+	fprintf(stderr, "init:m=%d:t=%d:avg=%gus\n", m, t, d/niter);
+}
+
+int main(int argc, char *argv[])
+{
+	int m, t, m1 = 5, m2 = 16, t1 = 1, t2 = 64;
+
+	if (argc >= 2) {
+		m1 = m2 = atoi(argv[1]);
+	}
+	if (argc >= 3) {
+		t1 = t2 = atoi(argv[2]);
+	}
+	srand48(0);
+
+	for (m = m1; m <= m2; m++) {
+		for (t = t1; t <= t2; t *= 2) {
+			if (m*t < (1 << m)-1) {
+				bch_test_init(m, t);
+			}
+		}
+	}
+	return 0;
+}
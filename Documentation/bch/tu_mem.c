@@ -1,7 +1,7 @@
 /*
  * BCH library tests
  *
- * Memory leak and fault injection test.
+ * Memory leak, fault injection, table sharing and allocation options test.
  *
  * Usage: ./tu_mem
  *
@@ -67,10 +67,161 @@ static void my_free(void *ptr)
 
 #include "../../lib/bch.c"
 
+static void bch_test_sharing(void)
+{
+	struct bch_control *bch1, *bch2, *bch3;
+
+	fprintf(stderr, "checking table sharing between instances\n");
+
+	bch1 = init_bch(13, 4, 0);
+	bch2 = init_bch(13, 8, 0);
+	bch3 = init_bch(13, 4, 0);
+	assert(bch1 && bch2 && bch3);
+
+	/* same (m,prim_poly): field tables are shared */
+	assert(bch1->a_pow_tab == bch2->a_pow_tab);
+	assert(bch1->a_log_tab == bch2->a_log_tab);
+	assert(bch1->xi_tab == bch2->xi_tab);
+	/* encoding tables are only shared for the same (m,t,prim_poly) */
+	assert(bch1->mod8_tab != bch2->mod8_tab);
+	assert(bch1->mod8_tab == bch3->mod8_tab);
+	assert(bch1->ecc_buf != bch3->ecc_buf);
+
+	/* shared tables must survive release of other instances */
+	free_bch(bch1);
+	assert(bch3->gf->refcount == 2);
+	assert(bch3->enc->refcount == 1);
+	free_bch(bch2);
+	assert(bch3->gf->refcount == 1);
+	free_bch(bch3);
+	assert(allocated == 0);
+}
+
+/* user allocator carving arenas out of a static pool */
+static uint8_t pool[1 << 20];
+static size_t pool_used;
+static int pool_allocs;
+
+static void *pool_alloc(size_t size, void *priv)
+{
+	void *ptr;
+
+	assert(priv == pool);
+	if (pool_used+size > sizeof(pool))
+		return NULL;
+	ptr = pool+pool_used;
+	pool_used += size;
+	pool_allocs++;
+	return ptr;
+}
+
+static void pool_free(void *ptr, size_t size, void *priv)
+{
+	assert((ptr >= (void *)pool) && (ptr < (void *)(pool+sizeof(pool))));
+	pool_allocs--;
+}
+
+static int is_aligned(const void *ptr)
+{
+	return !(((unsigned long)ptr) % L1_CACHE_BYTES);
+}
+
+static void check_arena(struct bch_control *bch, struct bch_control *ref)
+{
+	unsigned int i;
+	uint8_t data[512], ecc[64], ecc_ref[64];
+
+	assert(is_aligned(bch) && is_aligned(bch->ecc_buf) &&
+	       is_aligned(bch->syn) && is_aligned(bch->elp));
+	for (i = 0; i < ARRAY_SIZE(bch->poly_2t); i++) {
+		assert(is_aligned(bch->poly_2t[i]));
+	}
+	for (i = 0; i < sizeof(data); i++) {
+		data[i] = lrand48();
+	}
+	memset(ecc, 0, sizeof(ecc));
+	memset(ecc_ref, 0, sizeof(ecc_ref));
+	encode_bch(bch, data, sizeof(data), ecc);
+	encode_bch(ref, data, sizeof(data), ecc_ref);
+	assert(!memcmp(ecc, ecc_ref, sizeof(ecc)));
+}
+
+static void bch_test_opts(void)
+{
+	struct bch_control *bch, *ref;
+	struct bch_opts opts;
+	const uint8_t *lo, *hi;
+	size_t size;
+
+	fprintf(stderr, "checking allocation options\n");
+	ref = init_bch(13, 8, 0);
+	assert(ref);
+
+	/* default options: one arena, shared tables */
+	memset(&opts, 0, sizeof(opts));
+	bch = init_bch_opts(13, 8, 0, &opts);
+	assert(bch && (bch->mod8_tab == ref->mod8_tab));
+	check_arena(bch, ref);
+	free_bch(bch);
+
+	/* private tables are laid out in the arena, after work buffers */
+	opts.flags = BCH_OPT_PRIVATE_TABLES;
+	bch = init_bch_opts(13, 8, 0, &opts);
+	assert(bch && !bch->gf && !bch->enc);
+	assert(bch->mod8_tab != ref->mod8_tab);
+	lo = bch->arena;
+	hi = lo+bch->arena_size;
+	assert(((const uint8_t *)bch->a_pow_tab > (const uint8_t *)bch->ecc_buf)
+	       && ((const uint8_t *)bch->mod8_tab < hi));
+	assert(!memcmp(bch->a_log_tab, ref->a_log_tab,
+		       8192*sizeof(*ref->a_log_tab)));
+	assert(!memcmp(bch->xi_tab, ref->xi_tab, 13*4));
+	check_arena(bch, ref);
+	free_bch(bch);
+
+	/* user allocator, with or without private tables */
+	opts.alloc = pool_alloc;
+	opts.free = pool_free;
+	opts.priv = pool;
+	for (opts.flags = 0; opts.flags <= BCH_OPT_PRIVATE_TABLES;
+	     opts.flags++) {
+		pool_used = 0;
+		bch = init_bch_opts(13, 8, 0, &opts);
+		assert(bch && (pool_allocs == 1));
+		assert(((uint8_t *)bch >= pool) &&
+		       ((uint8_t *)bch < pool+pool_used));
+		check_arena(bch, ref);
+		free_bch(bch);
+		assert(pool_allocs == 0);
+	}
+	/* pool too small for m=17 private tables */
+	pool_used = 0;
+	opts.flags = BCH_OPT_PRIVATE_TABLES;
+	bch = init_bch_opts(17, 8, 0, &opts);
+	assert(!bch && !pool_allocs);
+
+	/* an allocator requires a release function */
+	opts.free = NULL;
+	assert(!init_bch_opts(13, 8, 0, &opts));
+
+	/* huge pages and prefaulting fall back to regular pages if needed */
+	memset(&opts, 0, sizeof(opts));
+	opts.flags = BCH_OPT_PRIVATE_TABLES|BCH_OPT_HUGEPAGE|BCH_OPT_POPULATE;
+	bch = init_bch_opts(13, 8, 0, &opts);
+	assert(bch);
+	size = bch->arena_size;
+	assert(!(size % sysconf(_SC_PAGESIZE)));
+	check_arena(bch, ref);
+	free_bch(bch);
+
+	free_bch(ref);
+	assert(allocated == 0);
+}
+
 int main(void)
 {
 	struct bch_control *bch;
-	int m, t, m1 = 5, m2 = 15;
+	int m, t, m1 = 5, m2 = BCH_MAX_M;
 
 	for (m = m1; m <= m2; m++) {
 		for (t = 4; t <= 16; t++) {
@@ -82,11 +233,32 @@ int main(void)
 			assert(allocated == 0);
 		}
 	}
+	bch_test_sharing();
+	bch_test_opts();
+
 	/* inject fault */
 	fault = 2;
 	bch = init_bch(13, 4, 0);
 	assert(bch == NULL);
 	assert(allocated == 0);
 
+	/* inject faults at various allocation steps */
+	for (fault = 3; fault < 32; fault++) {
+		count = 0;
+		bch = init_bch(13, 4, 0);
+		free_bch(bch);
+		assert(allocated == 0);
+	}
+
+	/* same with private tables */
+	for (fault = 2; fault < 8; fault++) {
+		struct bch_opts opts = {.flags = BCH_OPT_PRIVATE_TABLES};
+
+		count = 0;
+		bch = init_bch_opts(13, 4, 0, &opts);
+		free_bch(bch);
+		assert(allocated == 0);
+	}
+
 	return 0;
 }
@@ -0,0 +1,412 @@
+/*
+ * BCH library tests
+ *
+ * Microbenchmarks of Galois field primitives, polynomial operations and
+ * individual root finders, timed in isolation on random inputs. Results are
+ * given in nanoseconds per operation; destructive operations (BTZ root
+ * finding, polynomial remainder and gcd) include the cost of copying their
+ * input.
+ *
+ * Usage: ./tu_micro [m ...]
+ *
+ * Default is all values of m in range [5;20].
+ *
+ * Copyright (C) 2011 Parrot S.A.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+/* build chien_search() too; BTZ is then called as (find_poly_roots)() */
+#define USE_CHIEN_SEARCH
+#include "../../lib/bch.c"
+
+#define NVAL           1024            /* random field elements */
+#define NPOLY          64              /* random polynomials per degree */
+#define MAX_DEG        8               /* degree of large polynomials */
+#define MIN_US         20000           /* minimum duration of a benchmark */
+
+static unsigned int val_a[NVAL], val_b[NVAL];
+static struct gf_poly *polys[MAX_DEG+1][NPOLY], *dividends[NPOLY];
+static unsigned int affine[NPOLY][3], rows[NPOLY][32];
+static struct gf_poly *tmp1, *tmp2, *tmp3;
+static unsigned int len, pdeg;
+
+typedef unsigned int (*bench_fn)(struct bch_control *bch, unsigned int n);
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e6+ts.tv_nsec/1e3;
+}
+
+static unsigned int random_elt(struct bch_control *bch)
+{
+	return 1+(lrand48() % bch->n);
+}
+
+/* sized like bch->elp, which BTZ factorization splits in place */
+static struct gf_poly *alloc_poly(unsigned int d)
+{
+	struct gf_poly *p = calloc(d+1, sizeof(struct gf_poly_deg1));
+
+	assert(p);
+	return p;
+}
+
+/* multiply polynomial p by (X+r) */
+static void poly_mul_root(struct bch_control *bch, struct gf_poly *p,
+			  unsigned int r)
+{
+	int i;
+
+	p->c[p->deg+1] = 0;
+	for (i = p->deg+1; i > 0; i--) {
+		p->c[i] = p->c[i-1]^gf_mul(bch, r, p->c[i]);
+	}
+	p->c[0] = gf_mul(bch, r, p->c[0]);
+	p->deg++;
+}
+
+/* build a polynomial of degree d with d distinct nonzero roots */
+static void random_split_poly(struct bch_control *bch, struct gf_poly *p,
+			      unsigned int d)
+{
+	unsigned int i, j, r[d];
+
+	p->deg = 0;
+	p->c[0] = 1;
+	for (i = 0; i < d; i++) {
+		do {
+			r[i] = random_elt(bch);
+			for (j = 0; (j < i) && (r[j] != r[i]); j++)
+				;
+		} while (j < i);
+		poly_mul_root(bch, p, r[i]);
+	}
+}
+
+/*
+ * build an affine polynomial X^4+aX^2+bX+c with 4 roots: L(X) = X(X+u)(X+v)
+ * (X+u+v) is linear over GF(2), and L(X)+L(r) vanishes on r+span(u,v)
+ */
+static void random_affine4(struct bch_control *bch, unsigned int *abc)
+{
+	unsigned int u, v, r;
+	struct gf_poly *p = tmp1;
+
+	do {
+		u = random_elt(bch);
+		v = random_elt(bch);
+	} while (u == v);
+	r = random_elt(bch);
+
+	p->deg = 1;
+	p->c[0] = 0;
+	p->c[1] = 1;
+	poly_mul_root(bch, p, u);
+	poly_mul_root(bch, p, v);
+	poly_mul_root(bch, p, u^v);
+	assert(!p->c[0] && !p->c[3] && (p->c[4] == 1));
+
+	abc[0] = p->c[2];
+	abc[1] = p->c[1];
+	abc[2] = gf_sqr(bch, gf_sqr(bch, r))^gf_mul(bch, abc[0],
+						    gf_sqr(bch, r))^
+		gf_mul(bch, abc[1], r);
+}
+
+/* build transposed linear system, as find_affine4_roots() would */
+static void build_rows(struct bch_control *bch, const unsigned int *abc,
+		       unsigned int *r)
+{
+	int i, j, k, size = (GF_M(bch) < 16) ? 16 : 32;
+	unsigned int mask, t;
+
+	memset(r, 0, 32*sizeof(*r));
+	j = a_log(bch, abc[1]);
+	k = a_log(bch, abc[0]);
+	r[0] = abc[2];
+	for (i = 0; i < (int)GF_M(bch); i++) {
+		r[i+1] = bch->a_pow_tab[4*i]^
+			(abc[0] ? bch->a_pow_tab[mod_s(bch, k)] : 0)^
+			(abc[1] ? bch->a_pow_tab[mod_s(bch, j)] : 0);
+		j++;
+		k += 2;
+	}
+	j = size/2;
+	for (mask = (1u << j)-1; j != 0; j >>= 1, mask ^= (mask << j)) {
+		for (k = 0; k < size; k = (k+j+1) & ~j) {
+			t = ((r[k] >> j)^r[k+j]) & mask;
+			r[k] ^= (t << j);
+			r[k+j] ^= t;
+		}
+	}
+}
+
+static unsigned int bench_gf_mul(struct bch_control *bch, unsigned int n)
+{
+	unsigned int i, x = 0;
+
+	for (i = 0; i < n; i++) {
+		x ^= gf_mul(bch, val_a[i % NVAL], val_b[i % NVAL]);
+	}
+	return x;
+}
+
+static unsigned int bench_gf_sqr(struct bch_control *bch, unsigned int n)
+{
+	unsigned int i, x = 0;
+
+	for (i = 0; i < n; i++) {
+		x ^= gf_sqr(bch, val_a[i % NVAL]);
+	}
+	return x;
+}
+
+static unsigned int bench_gf_div(struct bch_control *bch, unsigned int n)
+{
+	unsigned int i, x = 0;
+
+	for (i = 0; i < n; i++) {
+		x ^= gf_div(bch, val_a[i % NVAL], val_b[i % NVAL]);
+	}
+	return x;
+}
+
+static unsigned int bench_gf_inv(struct bch_control *bch, unsigned int n)
+{
+	unsigned int i, x = 0;
+
+	for (i = 0; i < n; i++) {
+		x ^= gf_inv(bch, val_a[i % NVAL]);
+	}
+	return x;
+}
+
+#define BENCH_DEG_ROOTS(_d)						\
+static unsigned int bench_deg##_d(struct bch_control *bch, unsigned int n) \
+{									\
+	unsigned int i, x = 0, roots[4];				\
+									\
+	for (i = 0; i < n; i++) {					\
+		x += find_poly_deg##_d##_roots(bch,			\
+					       polys[_d][i % NPOLY],	\
+					       roots);			\
+	}								\
+	assert(x == _d*n);						\
+	return x;							\
+}
+
+BENCH_DEG_ROOTS(1)
+BENCH_DEG_ROOTS(2)
+BENCH_DEG_ROOTS(3)
+BENCH_DEG_ROOTS(4)
+
+static unsigned int bench_affine4(struct bch_control *bch, unsigned int n)
+{
+	unsigned int i, x = 0, roots[4];
+	const unsigned int *abc;
+
+	for (i = 0; i < n; i++) {
+		abc = affine[i % NPOLY];
+		x += find_affine4_roots(bch, abc[0], abc[1], abc[2], roots);
+	}
+	assert(x == 4*n);
+	return x;
+}
+
+static unsigned int bench_linear(struct bch_control *bch, unsigned int n)
+{
+	unsigned int i, x = 0, r[32], sol[4];
+
+	for (i = 0; i < n; i++) {
+		memcpy(r, rows[i % NPOLY], sizeof(r));
+		x += solve_linear_system(bch, r, sol, 4);
+	}
+	assert(x == 4*n);
+	return x;
+}
+
+static unsigned int bench_poly_mod(struct bch_control *bch, unsigned int n)
+{
+	unsigned int i, x = 0;
+
+	for (i = 0; i < n; i++) {
+		gf_poly_copy(tmp1, dividends[i % NPOLY]);
+		gf_poly_mod(bch, tmp1, polys[pdeg][i % NPOLY], NULL);
+		x ^= tmp1->c[0];
+	}
+	return x;
+}
+
+static unsigned int bench_poly_gcd(struct bch_control *bch, unsigned int n)
+{
+	unsigned int i, x = 0;
+
+	for (i = 0; i < n; i++) {
+		gf_poly_copy(tmp1, dividends[i % NPOLY]);
+		gf_poly_copy(tmp2, polys[pdeg][i % NPOLY]);
+		x ^= gf_poly_gcd(bch, tmp1, tmp2)->deg;
+	}
+	return x;
+}
+
+static unsigned int bench_trace(struct bch_control *bch, unsigned int n)
+{
+	unsigned int i, x = 0;
+
+	for (i = 0; i < n; i++) {
+		compute_trace_bk_mod(bch, 1, polys[pdeg][i % NPOLY], tmp1,
+				     tmp2);
+		x ^= tmp2->deg;
+	}
+	return x;
+}
+
+static unsigned int bench_btz(struct bch_control *bch, unsigned int n)
+{
+	unsigned int i, x = 0;
+
+	for (i = 0; i < n; i++) {
+		gf_poly_copy(tmp3, polys[pdeg][i % NPOLY]);
+		x += (find_poly_roots)(bch, 1, tmp3, bch->errloc);
+	}
+	assert(x == pdeg*n);
+	return x;
+}
+
+static unsigned int bench_chien(struct bch_control *bch, unsigned int n)
+{
+	unsigned int i, x = 0;
+
+	for (i = 0; i < n; i++) {
+		x += chien_search(bch, len, polys[pdeg][i % NPOLY],
+				  bch->errloc);
+	}
+	return x;
+}
+
+static const struct {
+	const char     *name;
+	bench_fn        fn;
+} benches[] = {
+	{"gf_mul",              bench_gf_mul},
+	{"gf_sqr",              bench_gf_sqr},
+	{"gf_div",              bench_gf_div},
+	{"gf_inv",              bench_gf_inv},
+	{"deg1_roots",          bench_deg1},
+	{"deg2_roots",          bench_deg2},
+	{"deg3_roots",          bench_deg3},
+	{"deg4_roots",          bench_deg4},
+	{"affine4_roots",       bench_affine4},
+	{"solve_linear_system", bench_linear},
+	{"poly_mod",            bench_poly_mod},
+	{"poly_gcd",            bench_poly_gcd},
+	{"trace_bk_mod",        bench_trace},
+	{"btz_roots",           bench_btz},
+	{"chien_search",        bench_chien},
+};
+
+static volatile unsigned int sink;
+
+static void run_bench(struct bch_control *bch, int i)
+{
+	unsigned int n = 16;
+	double d;
+
+	/* double iteration count until benchmark lasts long enough */
+	for (;;) {
+		d = now_us();
+		sink ^= benches[i].fn(bch, n);
+		d = now_us()-d;
+		if (d >= MIN_US)
+			break;
+		n *= 2;
+	}
+	fprintf(stderr, "micro:m=%d:deg=%u:%s=%.2f ns/op\n", GF_M(bch), pdeg,
+		benches[i].name, d*1000.0/n);
+}
+
+static void bch_test_micro(int m)
+{
+	unsigned int i, d;
+	int t;
+	struct bch_control *bch = NULL;
+
+	/* largest capability up to MAX_DEG, to size polynomial buffers */
+	for (t = MAX_DEG; (t > 0) && !bch; t--) {
+		bch = init_bch(m, t, 0);
+	}
+	assert(bch);
+	pdeg = bch->t;
+	len = (bch->n-bch->ecc_bits)/8;
+	srand48(m);
+
+	for (i = 0; i < NVAL; i++) {
+		val_a[i] = random_elt(bch);
+		val_b[i] = random_elt(bch);
+	}
+	tmp1 = alloc_poly(2*MAX_DEG);
+	tmp2 = alloc_poly(2*MAX_DEG);
+	tmp3 = alloc_poly(2*MAX_DEG);
+	for (i = 0; i < NPOLY; i++) {
+		for (d = 1; d <= MAX_DEG; d++) {
+			polys[d][i] = alloc_poly(2*MAX_DEG);
+			random_split_poly(bch, polys[d][i], d);
+		}
+		dividends[i] = alloc_poly(2*MAX_DEG);
+		random_split_poly(bch, dividends[i], 2*pdeg-1);
+		random_affine4(bch, affine[i]);
+		build_rows(bch, affine[i], rows[i]);
+	}
+
+	for (i = 0; i < sizeof(benches)/sizeof(benches[0]); i++) {
+		run_bench(bch, i);
+	}
+
+	for (i = 0; i < NPOLY; i++) {
+		for (d = 1; d <= MAX_DEG; d++) {
+			free(polys[d][i]);
+		}
+		free(dividends[i]);
+	}
+	free(tmp1);
+	free(tmp2);
+	free(tmp3);
+	free_bch(bch);
+}
+
+int main(int argc, char *argv[])
+{
+	int i, m;
+
+	if (argc > 1) {
+		for (i = 1; i < argc; i++) {
+			bch_test_micro(atoi(argv[i]));
+		}
+	} else {
+		for (m = 5; m <= BCH_MAX_M; m++) {
+			bch_test_micro(m);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * BCH library tests
+ *
+ * Multi-threaded scaling benchmark: N threads, each pinned to a cpu and using
+ * its own instance, encode or decode sectors for a fixed duration. Aggregate
+ * throughput and per-thread latency are reported for 1 thread up to the
+ * number of online cpus, with instances either sharing lookup tables (the
+ * default), or holding private copies (BCH_OPT_PRIVATE_TABLES), in order to
+ * expose cache contention on shared tables and false sharing.
+ *
+ * Usage: ./tu_mt [m t [ms]]
+ *
+ * Default is m=13, t=8, and 500 ms per measurement.
+ *
+ * Copyright (C) 2011 Parrot S.A.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <assert.h>
+
+#include "../../lib/bch.c"
+
+#define NSECT		32
+
+enum { OP_ENCODE, OP_DECODE };
+
+static const char * const op_names[] = {"encode", "decode"};
+
+struct worker {
+	pthread_t               thread;
+	int                     cpu;
+	int                     op;
+	unsigned int            flags;
+	pthread_barrier_t      *barrier;
+	unsigned long           count;
+	double                  elapsed;
+	size_t                  footprint;
+};
+
+static int m = 13, t = 8, len;
+static int stop;
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e6+ts.tv_nsec/1e3;
+}
+
+static inline unsigned int rev8(unsigned int x)
+{
+	return (x & ~7)|(7-(x & 7));
+}
+
+/*
+ * prepare encoded sectors with 0..t distinct bit errors; the instance and
+ * buffers are allocated by the worker thread itself, on its own cpu
+ */
+static void init_sectors(struct bch_control *bch, uint8_t **data, int *nerr,
+			 unsigned int seed)
+{
+	int i, j, k, ok;
+	unsigned int nbits, vec[t];
+	unsigned short xsubi[3] = {seed, seed >> 16, 0x330e};
+
+	nbits = 8*len+bch->ecc_bits;
+	for (i = 0; i < NSECT; i++) {
+		data[i] = calloc(len+bch->ecc_bytes, 1);
+		assert(data[i]);
+		for (j = 0; j < len; j++) {
+			data[i][j] = nrand48(xsubi);
+		}
+		encode_bch(bch, data[i], len, data[i]+len);
+		nerr[i] = i % (t+1);
+		for (j = 0; j < nerr[i]; j++) {
+			do {
+				vec[j] = rev8(nrand48(xsubi) % nbits);
+				for (k = 0, ok = 1; k < j; k++) {
+					ok &= (vec[k] != vec[j]);
+				}
+			} while (!ok);
+			data[i][vec[j]/8] ^= 1 << (vec[j] & 7);
+		}
+	}
+}
+
+static void *worker_run(void *arg)
+{
+	struct worker *w = arg;
+	struct bch_opts opts = {.flags = w->flags};
+	struct bch_control *bch;
+	uint8_t *data[NSECT], ecc[(m*t+7)/8];
+	unsigned int errloc[t];
+	int i, ret, nerr[NSECT];
+	cpu_set_t set;
+	double t0;
+
+	CPU_ZERO(&set);
+	CPU_SET(w->cpu, &set);
+	sched_setaffinity(0, sizeof(set), &set);
+
+	bch = init_bch_opts(m, t, 0, &opts);
+	assert(bch);
+	w->footprint = bch->arena_size;
+	init_sectors(bch, data, nerr, w->cpu+1);
+	memset(ecc, 0, sizeof(ecc));
+
+	pthread_barrier_wait(w->barrier);
+	t0 = now_us();
+	while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+		for (i = 0; i < NSECT; i++) {
+			if (w->op == OP_ENCODE) {
+				encode_bch(bch, data[i], len, ecc);
+				continue;
+			}
+			ret = decode_bch(bch, data[i], len, data[i]+len, NULL,
+					 NULL, errloc);
+			assert(ret == nerr[i]);
+		}
+		w->count += NSECT;
+	}
+	w->elapsed = now_us()-t0;
+
+	for (i = 0; i < NSECT; i++) {
+		free(data[i]);
+	}
+	free_bch(bch);
+	return NULL;
+}
+
+static void bench_mt(int nthreads, int ncpus, int op, unsigned int flags,
+		     int ms)
+{
+	int i, ret;
+	struct worker w[nthreads];
+	pthread_barrier_t barrier;
+	double thr = 0.0, lat, lat_sum = 0.0, lat_max = 0.0;
+
+	ret = pthread_barrier_init(&barrier, NULL, nthreads+1);
+	assert(ret == 0);
+	memset(w, 0, sizeof(w));
+	stop = 0;
+	for (i = 0; i < nthreads; i++) {
+		w[i].cpu = i % ncpus;
+		w[i].op = op;
+		w[i].flags = flags;
+		w[i].barrier = &barrier;
+		ret = pthread_create(&w[i].thread, NULL, worker_run, &w[i]);
+		assert(ret == 0);
+	}
+	pthread_barrier_wait(&barrier);
+	usleep(ms*1000);
+	__atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(w[i].thread, NULL);
+		assert(w[i].count);
+		thr += w[i].count*8.0*len/w[i].elapsed;
+		lat = w[i].elapsed/w[i].count;
+		lat_sum += lat;
+		if (lat > lat_max)
+			lat_max = lat;
+	}
+	pthread_barrier_destroy(&barrier);
+
+	fprintf(stderr, "mt:m=%d:t=%d:len=%d:tables=%s:op=%s:threads=%d:"
+		"thr=%.0f:lat=%.3f:lat_max=%.3f:footprint=%zu\n", m, t, len,
+		(flags & BCH_OPT_PRIVATE_TABLES) ? "private" : "shared",
+		op_names[op], nthreads, thr, lat_sum/nthreads, lat_max,
+		w[0].footprint);
+}
+
+int main(int argc, char *argv[])
+{
+	int n, op, ncpus, ms = 500;
+	unsigned int flags;
+	struct bch_opts opts = {.flags = BCH_OPT_PRIVATE_TABLES};
+	struct bch_control *bch, *priv;
+
+	if (argc > 2) {
+		m = atoi(argv[1]);
+		t = atoi(argv[2]);
+	}
+	if (argc > 3)
+		ms = atoi(argv[3]);
+	len = (1 << (m-1))/8;
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	fprintf(stderr, "%d cpus, throughput in Mbit/s, latency in us, "
+		"footprint in bytes per thread\n", ncpus);
+
+	/* size of tables shared by all instances, unless private */
+	bch = init_bch(m, t, 0);
+	priv = init_bch_opts(m, t, 0, &opts);
+	assert(bch && priv);
+	fprintf(stderr, "mt:m=%d:t=%d:shared_tables=%zu\n", m, t,
+		priv->arena_size-bch->arena_size);
+	free_bch(priv);
+	free_bch(bch);
+
+	for (flags = 0; flags <= BCH_OPT_PRIVATE_TABLES;
+	     flags += BCH_OPT_PRIVATE_TABLES) {
+		for (op = OP_ENCODE; op <= OP_DECODE; op++) {
+			for (n = 1; n < ncpus; n *= 2) {
+				bench_mt(n, ncpus, op, flags, ms);
+			}
+			bench_mt(ncpus, ncpus, op, flags, ms);
+		}
+	}
+	return 0;
+}
@@ -2,7 +2,7 @@
  * BCH library tests
  *
  * Test error correction of all degree <= 4 polynomials for values m in range
- * [5;7], then 1000000000 random vectors for each value m in range [8;15].
+ * [5;7], then 1000000000 random vectors for each value m in range [8;20].
  *
  * Usage: ./tu_poly4
  *
@@ -155,7 +155,7 @@ int main(void)
 	for (m = 5; m <= 7; m++) {
 		bch_test_deg4_full(m);
 	}
-	for (m = 8; m <= 15; m++) {
+	for (m = 8; m <= BCH_MAX_M; m++) {
 		bch_test_deg4_random(m, 1000000000);
 	}
 
@@ -0,0 +1,254 @@
+/*
+ * BCH library tests
+ *
+ * Primitive polynomial search: list primitive polynomials of degree m, ranked
+ * by weight (number of nonzero terms) and then by degree of their remaining
+ * terms, since low weight polynomials allow cheaper reductions, e.g. with
+ * carry-less multiplication. Default polynomials used by init_bch() are
+ * checked, as well as the number of polynomials found.
+ *
+ * A polynomial P of degree m is primitive if X has order 2^m-1 modulo P, i.e.
+ * X^(2^m-1) = 1 and X^((2^m-1)/p) != 1 for each prime factor p of 2^m-1.
+ * Candidates are split across threads.
+ *
+ * Usage: ./tu_prim [-j threads] [-w weight] [m ...]
+ *
+ * Default is all values of m in range [5;20], one thread per cpu, and only
+ * listing polynomials of the lowest weight found; option -w lists all
+ * polynomials up to the given weight.
+ *
+ * Copyright (C) 2011 Parrot S.A.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "../../lib/bch.c"
+
+#define MIN_M 5
+#define MAX_M BCH_MAX_M
+
+struct search {
+	unsigned int            m;
+	unsigned int            nfactors;
+	unsigned int            factors[MAX_M];
+	unsigned int            nthreads;
+	uint8_t                *prim;
+};
+
+struct worker {
+	pthread_t               thread;
+	struct search          *s;
+	unsigned int            id;
+};
+
+/* multiply a and b modulo poly of degree m */
+static unsigned int mul_mod(unsigned int a, unsigned int b, unsigned int poly,
+			    unsigned int m)
+{
+	unsigned int r = 0;
+
+	while (b) {
+		if (b & 1)
+			r ^= a;
+		b >>= 1;
+		a <<= 1;
+		if (a & (1u << m))
+			a ^= poly;
+	}
+	return r;
+}
+
+/* compute X^e modulo poly of degree m */
+static unsigned int pow_x_mod(unsigned int e, unsigned int poly,
+			      unsigned int m)
+{
+	unsigned int r = 1, x = 2;
+
+	while (e) {
+		if (e & 1)
+			r = mul_mod(r, x, poly, m);
+		x = mul_mod(x, x, poly, m);
+		e >>= 1;
+	}
+	return r;
+}
+
+static int is_primitive(const struct search *s, unsigned int poly)
+{
+	unsigned int i;
+	const unsigned int n = (1u << s->m)-1;
+
+	if (pow_x_mod(n, poly, s->m) != 1)
+		return 0;
+	for (i = 0; i < s->nfactors; i++) {
+		if (pow_x_mod(n/s->factors[i], poly, s->m) == 1)
+			return 0;
+	}
+	return 1;
+}
+
+static void *worker_run(void *arg)
+{
+	struct worker *w = arg;
+	struct search *s = w->s;
+	unsigned int i;
+
+	for (i = 2*w->id+1; i < (1u << s->m); i += 2*s->nthreads) {
+		/* skip polynomials divisible by X+1, X is already excluded */
+		if (hweight32(i) & 1)
+			continue;
+		s->prim[i] = is_primitive(s, (1u << s->m)|i);
+	}
+	return NULL;
+}
+
+/* distinct prime factors of n, and Euler's totient of n */
+static unsigned int factor(struct search *s, unsigned int n)
+{
+	unsigned int p, phi = n;
+
+	s->nfactors = 0;
+	for (p = 2; p*p <= n; p++) {
+		if (n % p)
+			continue;
+		s->factors[s->nfactors++] = p;
+		phi = phi/p*(p-1);
+		while ((n % p) == 0)
+			n /= p;
+	}
+	if (n > 1) {
+		s->factors[s->nfactors++] = n;
+		phi = phi/n*(n-1);
+	}
+	return phi;
+}
+
+/* weight of polynomial X^m+lo */
+static unsigned int weight(unsigned int lo)
+{
+	return hweight32(lo)+1;
+}
+
+/* rank by weight, then by degree of lower terms, then by value */
+static int rank_cmp(const void *pa, const void *pb)
+{
+	unsigned int a = *(const unsigned int *)pa;
+	unsigned int b = *(const unsigned int *)pb;
+
+	if (weight(a) != weight(b))
+		return (int)weight(a)-(int)weight(b);
+	if (fls(a) != fls(b))
+		return fls(a)-fls(b);
+	return (a > b)-(a < b);
+}
+
+static void search_prim(unsigned int m, unsigned int nthreads,
+			unsigned int max_weight)
+{
+	unsigned int i, w, def, phi, count = 0, *list;
+	int ret;
+	struct search s;
+	struct worker workers[nthreads];
+	struct bch_control *bch;
+
+	memset(&s, 0, sizeof(s));
+	s.m = m;
+	s.nthreads = nthreads;
+	s.prim = calloc(1u << m, 1);
+	list = malloc((1u << m)*sizeof(*list));
+	assert(s.prim && list);
+	phi = factor(&s, (1u << m)-1);
+
+	for (i = 0; i < nthreads; i++) {
+		workers[i].s = &s;
+		workers[i].id = i;
+		ret = pthread_create(&workers[i].thread, NULL, worker_run,
+				     &workers[i]);
+		assert(ret == 0);
+	}
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(workers[i].thread, NULL);
+	}
+
+	/* lower terms of primitive polynomials, X^m is implicit */
+	for (i = 0; i < (1u << m); i++) {
+		if (s.prim[i])
+			list[count++] = i;
+	}
+	qsort(list, count, sizeof(*list), rank_cmp);
+	/* there are phi(2^m-1)/m primitive polynomials of degree m */
+	assert(count == phi/m);
+
+	/* default polynomial: X^m = a^m in GF(2^m) */
+	bch = init_bch(m, 1, 0);
+	assert(bch);
+	def = bch->a_pow_tab[m];
+	free_bch(bch);
+	assert(s.prim[def]);
+
+	w = max_weight ? max_weight : weight(list[0]);
+	fprintf(stderr, "prim:m=%u:count=%u:default=0x%x:default_weight=%u:"
+		"min_weight=%u\n", m, count, (1u << m)|def, weight(def),
+		weight(list[0]));
+	for (i = 0; (i < count) && (weight(list[i]) <= w); i++) {
+		fprintf(stderr, "prim:m=%u:rank=%u:poly=0x%x:weight=%u%s\n", m,
+			i+1, (1u << m)|list[i], weight(list[i]),
+			(list[i] == def) ? ":default" : "");
+	}
+	free(list);
+	free(s.prim);
+}
+
+int main(int argc, char *argv[])
+{
+	int c, i;
+	unsigned int m, max_weight = 0, nthreads;
+
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	while ((c = getopt(argc, argv, "j:w:")) != -1) {
+		switch (c) {
+		case 'j':
+			nthreads = atoi(optarg);
+			break;
+		case 'w':
+			max_weight = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-j threads] [-w weight] "
+				"[m ...]\n", argv[0]);
+			exit(1);
+		}
+	}
+	assert(nthreads > 0);
+
+	if (optind < argc) {
+		for (i = optind; i < argc; i++) {
+			m = atoi(argv[i]);
+			assert((m >= MIN_M) && (m <= MAX_M));
+			search_prim(m, nthreads, max_weight);
+		}
+	} else {
+		for (m = MIN_M; m <= MAX_M; m++) {
+			search_prim(m, nthreads, max_weight);
+		}
+	}
+	return 0;
+}
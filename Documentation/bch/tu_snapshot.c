@@ -0,0 +1,151 @@
+/*
+ * BCH library tests
+ *
+ * Check save/load of lookup table snapshots, from memory and mapped files.
+ *
+ * Usage: ./tu_snapshot [m]
+ *
+ * If m is not specified, test all m values in range [5;16].
+ *
+ * Copyright (C) 2011 Parrot S.A.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../../lib/bch.c"
+
+static void compare_instances(struct bch_control *bch1,
+			      struct bch_control *bch2)
+{
+	int i, len, nerrors;
+	unsigned int bit, errloc[bch1->t];
+	uint8_t *data, ecc1[bch1->ecc_bytes], ecc2[bch1->ecc_bytes];
+
+	assert(bch1->m == bch2->m);
+	assert(bch1->t == bch2->t);
+	assert(bch1->n == bch2->n);
+	assert(bch1->ecc_bits == bch2->ecc_bits);
+	assert(bch1->ecc_bytes == bch2->ecc_bytes);
+	assert(!memcmp(bch1->a_pow_tab, bch2->a_pow_tab,
+		       (bch1->n+1)*sizeof(*bch1->a_pow_tab)));
+	assert(!memcmp(bch1->a_log_tab, bch2->a_log_tab,
+		       (bch1->n+1)*sizeof(*bch1->a_log_tab)));
+	assert(!memcmp(bch1->mod8_tab, bch2->mod8_tab,
+		       BCH_ECC_WORDS(bch1)*1024*sizeof(*bch1->mod8_tab)));
+	assert(!memcmp(bch1->xi_tab, bch2->xi_tab,
+		       bch1->m*sizeof(*bch1->xi_tab)));
+
+	len = (1 << (bch1->m-1))/8;
+	data = malloc(len);
+	assert(data);
+	for (i = 0; i < len; i++)
+		data[i] = lrand48() & 0xff;
+
+	memset(ecc1, 0, sizeof(ecc1));
+	memset(ecc2, 0, sizeof(ecc2));
+	encode_bch(bch1, data, len, ecc1);
+	encode_bch(bch2, data, len, ecc2);
+	assert(!memcmp(ecc1, ecc2, sizeof(ecc1)));
+
+	/* decode a single error with the loaded instance */
+	bit = lrand48() % (8*len);
+	data[bit/8] ^= 1 << (bit & 7);
+	nerrors = decode_bch(bch2, data, len, ecc1, NULL, NULL, errloc);
+	assert(nerrors == 1);
+	assert(errloc[0] == bit);
+
+	free(data);
+}
+
+static void bch_test_snapshot(int m, int t, const char *path)
+{
+	int size;
+	uint8_t *buf;
+	struct bch_snapshot_header *hdr;
+	struct bch_control *bch, *bch2;
+
+	fprintf(stderr, "m=%d:t=%d: checking snapshots\n", m, t);
+
+	bch = init_bch(m, t, 0);
+	assert(bch);
+
+	/* in-memory snapshot */
+	size = save_bch_snapshot(bch, NULL, 0);
+	assert(size > 0);
+	buf = malloc(size);
+	assert(buf);
+	assert(save_bch_snapshot(bch, buf, size-1) == -ENOSPC);
+	assert(save_bch_snapshot(bch, buf, size) == size);
+
+	bch2 = init_bch_snapshot(buf, size);
+	assert(bch2);
+	assert(bch2->gf == NULL);
+	compare_instances(bch, bch2);
+	free_bch(bch2);
+
+	/* truncated or corrupted snapshots must be rejected */
+	assert(init_bch_snapshot(buf, size-1) == NULL);
+	hdr = (struct bch_snapshot_header *)buf;
+	hdr->version++;
+	assert(init_bch_snapshot(buf, size) == NULL);
+	hdr->version--;
+	hdr->m++;
+	assert(init_bch_snapshot(buf, size) == NULL);
+	hdr->m--;
+	assert(init_bch_snapshot(buf+1, size-1) == NULL);
+	free(buf);
+
+	/* mapped snapshot file */
+	assert(save_bch_file(bch, path) == 0);
+	bch2 = init_bch_from_file(path);
+	assert(bch2);
+	assert(bch2->snapshot);
+	compare_instances(bch, bch2);
+	free_bch(bch2);
+	unlink(path);
+
+	free_bch(bch);
+}
+
+int main(int argc, char *argv[])
+{
+	int m, t, fd, m1 = 5, m2 = 16;
+	char path[] = "/tmp/tu_snapshot.XXXXXX";
+
+	if (argc == 2) {
+		m1 = m2 = atoi(argv[1]);
+	}
+	/* snapshot files are written by path, only reserve a unique name */
+	fd = mkstemp(path);
+	assert(fd >= 0);
+	close(fd);
+	srand48(0);
+
+	for (m = m1; m <= m2; m++) {
+		for (t = 1; t <= 16; t += 5) {
+			if (m*t < (1 << (m-1))) {
+				bch_test_snapshot(m, t, path);
+			}
+		}
+	}
+	assert(init_bch_from_file(path) == NULL);
+
+	return 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * BCH library tests
+ *
+ * Decoding statistics test: decode sectors with known error counts and check
+ * statistics returned by bch_get_stats(), then print the share of cycles
+ * spent in each decoding stage.
+ *
+ * Usage: ./tu_stats [m t]
+ *
+ * Default is m=13 and t=8.
+ *
+ * Copyright (C) 2011 Parrot S.A.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define CONFIG_BCH_STATS
+#include "../../lib/bch.c"
+
+#define NITER 2000
+
+static const char * const stage_names[BCH_STAGE_MAX] = {
+	[BCH_STAGE_ECC]       = "ecc",
+	[BCH_STAGE_SYNDROMES] = "syndromes",
+	[BCH_STAGE_ELP]       = "elp",
+	[BCH_STAGE_ROOTS]     = "roots",
+};
+
+static inline unsigned int rev8(unsigned int x)
+{
+	return (x & ~7)|(7-(x & 7));
+}
+
+static void corrupt(uint8_t *data, unsigned int nbits, int nerr)
+{
+	int i, j, ok;
+	unsigned int vec[nerr];
+
+	for (i = 0; i < nerr; i++) {
+		do {
+			/* make sure we stay in linear interval */
+			vec[i] = rev8(lrand48() % nbits);
+			for (j = 0, ok = 1; j < i; j++) {
+				ok &= (vec[j] != vec[i]);
+			}
+		} while (!ok);
+		data[vec[i]/8] ^= 1 << (vec[i] & 7);
+	}
+}
+
+static void bch_test_stats(int m, int t)
+{
+	int i, j, nerr, expected[t+2], batch_nerr[2];
+	unsigned int errloc[t], batch_errloc[2*t], soft_errloc[t+2], len, nbits;
+	unsigned int lrb[2] = {0, 1};
+	uint64_t total, roots;
+	struct bch_control *bch;
+	struct bch_stats stats;
+	uint8_t *ref, *buf;
+	const uint8_t *data[2], *ecc[2];
+
+	bch = init_bch(m, t, 0);
+	assert(bch);
+	len = (1 << (m-1))/8;
+	nbits = 8*len+bch->ecc_bits;
+
+	ref = calloc(len+bch->ecc_bytes, 1);
+	buf = malloc(len+bch->ecc_bytes);
+	assert(ref && buf);
+	for (i = 0; i < (int)len; i++) {
+		ref[i] = lrand48();
+	}
+	encode_bch(bch, ref, len, ref+len);
+	data[0] = ref;
+	data[1] = buf;
+	ecc[0] = ref+len;
+	ecc[1] = buf+len;
+
+	/* initial statistics are cleared */
+	assert(bch_get_stats(bch, &stats) == 0);
+	assert(!stats.decodes && !stats.einval && !stats.cycles[0]);
+
+	memset(expected, 0, sizeof(expected));
+	for (i = 0; i < NITER; i++) {
+		nerr = i % (t+2);
+		memcpy(buf, ref, len+bch->ecc_bytes);
+		corrupt(buf, nbits, nerr);
+		j = decode_bch(bch, buf, len, buf+len, NULL, NULL, errloc);
+		assert((nerr > t) || (j == nerr));
+		expected[(j < 0) ? t+1 : j]++;
+	}
+	/* invalid calls are not decodes */
+	assert(decode_bch(bch, NULL, len, NULL, NULL, NULL, errloc) ==
+	       -EINVAL);
+
+	assert(bch_get_stats(bch, &stats) == 0);
+	assert(stats.decodes == NITER);
+	assert(stats.einval == 1);
+	assert(stats.ebadmsg == (uint64_t)expected[t+1]);
+	for (i = 0; i <= t; i++) {
+		assert(stats.nerr[i] == (uint64_t)expected[i]);
+	}
+	/* locators of all sectors with errors were solved */
+	roots = stats.roots_btz+stats.roots_chien;
+	for (i = 0; i < 4; i++) {
+		roots += stats.roots_deg[i];
+	}
+	assert(roots <= NITER-(uint64_t)expected[0]);
+	assert(roots >= NITER-(uint64_t)expected[0]-expected[t+1]);
+	if (t >= 4) {
+		assert(stats.roots_deg[0] && stats.roots_deg[3]);
+	}
+	if (t > 4) {
+		assert(stats.roots_btz);
+	}
+	total = 0;
+	for (i = 0; i < BCH_STAGE_MAX; i++) {
+		assert(stats.cycles[i]);
+		total += stats.cycles[i];
+	}
+	fprintf(stderr, "stats:m=%d:t=%d:decodes=%llu:ebadmsg=%llu", m, t,
+		(unsigned long long)stats.decodes,
+		(unsigned long long)stats.ebadmsg);
+	for (i = 0; i < BCH_STAGE_MAX; i++) {
+		fprintf(stderr, ":%s=%.1f%%", stage_names[i],
+			100.0*stats.cycles[i]/total);
+	}
+	fprintf(stderr, "\n");
+
+	/* batch decoding accumulates the same statistics */
+	bch_reset_stats(bch);
+	assert(bch_get_stats(bch, &stats) == 0);
+	assert(!stats.decodes && !stats.nerr[0] && !stats.cycles[0]);
+
+	memcpy(buf, ref, len+bch->ecc_bytes);
+	corrupt(buf, nbits, 1);
+	assert(decode_bch_batch(bch, 2, data, len, ecc, batch_errloc,
+				batch_nerr) == 0);
+	assert(bch_get_stats(bch, &stats) == 0);
+	assert((stats.decodes == 2) && (stats.nerr[0] == 1) &&
+	       (stats.nerr[1] == 1) && (stats.roots_deg[0] == 1));
+
+	/* soft decoding is a single decode, whatever its number of trials */
+	bch_reset_stats(bch);
+	memcpy(buf, ref, len+bch->ecc_bytes);
+	for (i = 0; i <= t; i++) {
+		buf[i/8] ^= 1 << (i & 7);
+	}
+	nerr = decode_bch_soft(bch, buf, len, buf+len, lrb, 2, soft_errloc);
+	assert(bch_get_stats(bch, &stats) == 0);
+	assert(stats.decodes == 1);
+	assert(stats.ebadmsg == (nerr < 0));
+	roots = stats.roots_btz+stats.roots_chien;
+	for (i = 0; i < 4; i++) {
+		roots += stats.roots_deg[i];
+	}
+	assert(roots <= 1);
+
+	free(ref);
+	free(buf);
+	free_bch(bch);
+}
+
+int main(int argc, char *argv[])
+{
+	int m = 13, t = 8;
+
+	if (argc > 2) {
+		m = atoi(argv[1]);
+		t = atoi(argv[2]);
+	}
+	srand48(m*t);
+	bch_test_stats(m, t);
+	return 0;
+}
@@ -348,7 +348,7 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	assert((m >= 5) && (m <= 15));
+	assert((m >= 5) && (m <= BCH_MAX_M));
 	if (len == 0) {
 		len = 1 << (m-4);
 	}
@@ -1,7 +1,8 @@
 /*
  * BCH library tests
  *
- * Test BCH library encoding on unaligned data buffers.
+ * Test BCH library encoding on unaligned data buffers, and incremental ecc
+ * updates with update_ecc_bch().
  *
  * Usage: ./tu_unaligned tmax
  *
@@ -77,6 +78,60 @@ static void bch_test_unaligned(int m, int t)
 	free_bch(bch);
 }
 
+static void bch_test_update_ecc(int m, int t)
+{
+	int i, k, len, offset, n;
+	struct bch_control *bch;
+	uint8_t *data, *ecc, *old;
+
+	fprintf(stderr, "m=%d:t=%d: checking incremental ecc updates\n",
+		m, t);
+
+	bch = init_bch(m, t, 0);
+	assert(bch);
+
+	srand48(m);
+	len = (1 << (m-1))/8;
+	/* large values of t may not leave room for a full sector */
+	if (8*len > (int)(bch->n-bch->ecc_bits))
+		len = (bch->n-bch->ecc_bits)/8;
+
+	data = malloc(len);
+	ecc = malloc(2*bch->ecc_bytes);
+	old = malloc(len);
+	assert(data && ecc && old);
+	for (i = 0; i < len; i++) {
+		data[i] = lrand48() & 0xff;
+	}
+	memset(ecc, 0, bch->ecc_bytes);
+	encode_bch(bch, data, len, ecc);
+
+	for (k = 0; k < 1000; k++) {
+		/* modify a random range, sometimes up to the whole sector */
+		n = (k & 1) ? lrand48() % 16 : lrand48() % (len+1);
+		if (n > len)
+			n = len;
+		offset = lrand48() % (len-n+1);
+		memcpy(old, data+offset, n);
+		for (i = 0; i < n; i++) {
+			if (lrand48() & 1)
+				data[offset+i] = lrand48() & 0xff;
+		}
+		assert(update_ecc_bch(bch, ecc, len, offset, old, data+offset,
+				      n) == 0);
+
+		memset(ecc+bch->ecc_bytes, 0, bch->ecc_bytes);
+		encode_bch(bch, data, len, ecc+bch->ecc_bytes);
+		assert(memcmp(ecc, ecc+bch->ecc_bytes, bch->ecc_bytes) == 0);
+	}
+	assert(update_ecc_bch(bch, ecc, len, len, old, data, 1) == -EINVAL);
+
+	free(old);
+	free(ecc);
+	free(data);
+	free_bch(bch);
+}
+
 int main(int argc, char *argv[])
 {
 	int m, t, tmax;
@@ -89,6 +144,7 @@ int main(int argc, char *argv[])
 	for (m = 7; m <= 15; m++) {
 		for (t = 1; t <= tmax; t++) {
 			bch_test_unaligned(m, t);
+			bch_test_update_ecc(m, t);
 		}
 	}
 	return 0;
@@ -29,6 +29,83 @@
 
 #include <linux/types.h>
 
+/*
+ * largest supported Galois field order (see CONFIG_BCH_MAX_M in lib/bch.c),
+ * Galois field table entries are 16-bit up to m=16 and 32-bit above; variants
+ * built from lib/bch_spec.c use the tables of the generic build
+ */
+#if defined(CONFIG_BCH_MAX_M)
+#define BCH_MAX_M               (CONFIG_BCH_MAX_M)
+#elif defined(CONFIG_BCH_CONST_PARAMS) && !defined(BCH_SPEC_VARIANT)
+#define BCH_MAX_M               (CONFIG_BCH_CONST_M)
+#else
+#define BCH_MAX_M               16
+#endif
+
+#if BCH_MAX_M <= 16
+typedef uint16_t bch_gf_t;
+#else
+typedef uint32_t bch_gf_t;
+#endif
+
+/* maximum number of least reliable bits used by decode_bch_soft() */
+#define BCH_SOFT_MAX_LRB 16
+
+/* init_bch_opts() flags */
+#define BCH_OPT_PRIVATE_TABLES  0x1   /* build tables in instance arena */
+#define BCH_OPT_HUGEPAGE        0x2   /* use huge pages (userspace only) */
+#define BCH_OPT_POPULATE        0x4   /* prefault pages (userspace only) */
+#define BCH_OPT_LSB_FIRST       0x8   /* LSB-first data and ecc bit order */
+
+/**
+ * struct bch_opts - BCH instance options
+ * @flags:  BCH_OPT_* flags
+ * @alloc:  if not NULL, allocate instance arena with this function
+ * @free:   release an arena allocated with @alloc
+ * @priv:   caller private data, passed to @alloc and @free
+ */
+struct bch_opts {
+	unsigned int    flags;
+	void         *(*alloc)(size_t size, void *priv);
+	void          (*free)(void *ptr, size_t size, void *priv);
+	void           *priv;
+};
+
+/* decoding stages timed with CONFIG_BCH_STATS */
+enum bch_stage {
+	BCH_STAGE_ECC,          /* ecc computation and comparison */
+	BCH_STAGE_SYNDROMES,    /* syndrome computation */
+	BCH_STAGE_ELP,          /* Berlekamp-Massey error locator polynomial */
+	BCH_STAGE_ROOTS,        /* error locator root finding */
+	BCH_STAGE_MAX
+};
+
+/* last bucket of the corrected error count histogram */
+#define BCH_STATS_NERR_MAX 64
+
+/**
+ * struct bch_stats - decoding statistics (CONFIG_BCH_STATS)
+ * @decodes:     number of decoded sectors, including failures
+ * @cycles:      cycles spent in each decoding stage, see enum bch_stage
+ * @nerr:        histogram of corrected error counts, the last bucket also
+ *               counts larger values
+ * @ebadmsg:     number of uncorrectable sectors
+ * @einval:      number of calls rejected with -EINVAL
+ * @roots_deg:   error locators of degree 1 to 4, solved with ad hoc methods
+ * @roots_btz:   error locators of degree > 4, factored with BTZ
+ * @roots_chien: error locators solved with a Chien search
+ */
+struct bch_stats {
+	uint64_t        decodes;
+	uint64_t        cycles[BCH_STAGE_MAX];
+	uint64_t        nerr[BCH_STATS_NERR_MAX+1];
+	uint64_t        ebadmsg;
+	uint64_t        einval;
+	uint64_t        roots_deg[4];
+	uint64_t        roots_btz;
+	uint64_t        roots_chien;
+};
+
 /**
  * struct bch_control - BCH control structure
  * @m:          Galois field order
@@ -44,8 +121,18 @@
  * @xi_tab:     GF(2^m) base for solving degree 2 polynomial roots
  * @syn:        syndrome buffer
  * @cache:      log-based polynomial representation buffer
+ * @errloc:     error locations buffer
  * @elp:        error locator polynomial
  * @poly_2t:    temporary polynomials of degree 2t
+ * @gf:         shared Galois field tables (a_pow_tab, a_log_tab, xi_tab)
+ * @enc:        shared encoding tables (mod8_tab)
+ * @snapshot:   mapped snapshot file holding lookup tables, if any
+ * @snapshot_size: mapped snapshot file size
+ * @spec:       encoder/decoder variant bound to the instance, if any
+ * @opts:       allocation options
+ * @arena:      memory block holding the structure and its work buffers
+ * @arena_size: arena size in bytes
+ * @stats:      decoding statistics, if enabled
  */
 struct bch_control {
 	unsigned int    m;
@@ -54,27 +141,101 @@ struct bch_control {
 	unsigned int    ecc_bits;
 	unsigned int    ecc_bytes;
 /* private: */
-	uint16_t       *a_pow_tab;
-	uint16_t       *a_log_tab;
-	uint32_t       *mod8_tab;
+	const bch_gf_t *a_pow_tab;
+	const bch_gf_t *a_log_tab;
+	const uint32_t *mod8_tab;
 	uint32_t       *ecc_buf;
 	uint32_t       *ecc_buf2;
-	unsigned int   *xi_tab;
+	const unsigned int *xi_tab;
 	unsigned int   *syn;
 	int            *cache;
+	unsigned int   *errloc;
 	struct gf_poly *elp;
 	struct gf_poly *poly_2t[4];
+	struct bch_gf_tables  *gf;
+	struct bch_enc_tables *enc;
+	void           *snapshot;
+	size_t          snapshot_size;
+	const struct bch_spec *spec;
+	struct bch_opts opts;
+	void           *arena;
+	size_t          arena_size;
+#if defined(CONFIG_BCH_STATS)
+	struct bch_stats stats;
+#endif
+};
+
+/**
+ * struct bch_fix - error locations grouped by byte
+ * @offset: byte offset of the error; values >= data length are located in ecc
+ * @mask:   XOR mask correcting bit errors in the byte
+ */
+struct bch_fix {
+	unsigned int    offset;
+	uint8_t         mask;
 };
 
 struct bch_control *init_bch(int m, int t, unsigned int prim_poly);
 
+struct bch_control *init_bch_opts(int m, int t, unsigned int prim_poly,
+				  const struct bch_opts *opts);
+
 void free_bch(struct bch_control *bch);
 
 void encode_bch(struct bch_control *bch, const uint8_t *data,
 		unsigned int len, uint8_t *ecc);
 
+int update_ecc_bch(struct bch_control *bch, uint8_t *ecc, unsigned int len,
+		   unsigned int offset, const uint8_t *old_bytes,
+		   const uint8_t *new_bytes, unsigned int n);
+
 int decode_bch(struct bch_control *bch, const uint8_t *data, unsigned int len,
 	       const uint8_t *recv_ecc, const uint8_t *calc_ecc,
 	       const unsigned int *syn, unsigned int *errloc);
 
+int decode_bch_batch(struct bch_control *bch, unsigned int nsect,
+		     const uint8_t * const *data, unsigned int len,
+		     const uint8_t * const *recv_ecc, unsigned int *errloc,
+		     int *nerr);
+
+int decode_bch_fix(struct bch_control *bch, const uint8_t *data,
+		   unsigned int len, const uint8_t *recv_ecc,
+		   const uint8_t *calc_ecc, const unsigned int *syn,
+		   struct bch_fix *fix);
+
+int correct_bch(struct bch_control *bch, uint8_t *data, unsigned int len,
+		uint8_t *ecc);
+
+int decode_bch_soft(struct bch_control *bch, const uint8_t *data,
+		    unsigned int len, const uint8_t *recv_ecc,
+		    const unsigned int *lrb, unsigned int nlrb,
+		    unsigned int *errloc);
+
+int compute_syndromes_bch(struct bch_control *bch, const uint8_t *data,
+			  unsigned int len, const uint8_t *recv_ecc,
+			  unsigned int *syn);
+
+int update_syndromes_bch(struct bch_control *bch, unsigned int *syn,
+			 unsigned int len, const uint8_t *old_data,
+			 const uint8_t *new_data, const uint8_t *old_ecc,
+			 const uint8_t *new_ecc);
+
+const char *bch_get_kernel(struct bch_control *bch);
+
+int bch_get_stats(struct bch_control *bch, struct bch_stats *stats);
+
+void bch_reset_stats(struct bch_control *bch);
+
+int bch_set_kernel(struct bch_control *bch, const char *name);
+
+int save_bch_snapshot(struct bch_control *bch, void *buf, size_t size);
+
+struct bch_control *init_bch_snapshot(const void *buf, size_t size);
+
+#if !defined(__KERNEL__)
+int save_bch_file(struct bch_control *bch, const char *path);
+
+struct bch_control *init_bch_from_file(const char *path);
+#endif
+
 #endif /* _BCH_H */
@@ -0,0 +1,76 @@
+/*
+ * Multi-threaded BCH decoding engine (userspace only)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Description:
+ *
+ * A pool of worker threads decoding jobs pushed into a submission ring, and
+ * posting results into a completion ring.
+ */
+#ifndef _BCH_ENGINE_H
+#define _BCH_ENGINE_H
+
+#include <linux/bch.h>
+
+/**
+ * struct bch_engine_job - decoding job
+ * @data:     received data
+ * @ecc:      received ecc
+ * @len:      data length in bytes
+ * @errloc:   output array of at least t error locations
+ * @nerr:     result, as returned by decode_bch()
+ * @priv:     caller private data
+ *
+ * Jobs are owned by the caller, and must not be modified between submission
+ * and completion.
+ */
+struct bch_engine_job {
+	const uint8_t  *data;
+	const uint8_t  *ecc;
+	unsigned int    len;
+	unsigned int   *errloc;
+	int             nerr;
+	void           *priv;
+};
+
+/**
+ * struct bch_engine_opts - decoding engine options
+ * @nworkers:  number of worker threads
+ * @ring_size: maximum number of jobs in flight, rounded up to a power of 2
+ * @batch:     maximum number of jobs dequeued at once by a worker
+ * @cpus:      if not NULL, worker i is pinned to cpu @cpus[i]
+ */
+struct bch_engine_opts {
+	unsigned int    nworkers;
+	unsigned int    ring_size;
+	unsigned int    batch;
+	const int      *cpus;
+};
+
+struct bch_engine;
+
+struct bch_engine *bch_engine_create(int m, int t, unsigned int prim_poly,
+				     const struct bch_engine_opts *opts);
+
+void bch_engine_destroy(struct bch_engine *engine);
+
+int bch_engine_submit(struct bch_engine *engine, struct bch_engine_job **jobs,
+		      unsigned int njobs);
+
+int bch_engine_reap(struct bch_engine *engine, struct bch_engine_job **jobs,
+		    unsigned int njobs, int wait);
+
+#endif /* _BCH_ENGINE_H */
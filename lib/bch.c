@@ -29,18 +29,78 @@
  * (optional) primitive polynomial parameters.
  *
  * Call encode_bch to compute and store ecc parity bytes to a given buffer.
+ * Call update_ecc_bch to update ecc parity bytes after a partial data change.
  * Call decode_bch to detect and locate errors in received data.
+ * Call decode_bch_batch to decode all sectors of a page in a single call.
+ * Call correct_bch to decode and correct data and ecc in place.
+ * Call decode_bch_soft to decode beyond t errors using unreliable bit hints.
+ * Call update_syndromes_bch to update syndromes of a re-read codeword.
  *
  * On systems supporting hw BCH features, intermediate results may be provided
  * to decode_bch in order to skip certain steps. See decode_bch() documentation
  * for details.
  *
+ * Data and ecc bits are processed MSB-first by default: bit 7 of the first
+ * byte is the first codeword bit. Flag BCH_OPT_LSB_FIRST of init_bch_opts()
+ * selects LSB-first bit order instead, as used by some hardware ecc engines;
+ * it is handled by the encoding tables and by error location conversions, so
+ * that data needs no bit reversal.
+ *
  * Option CONFIG_BCH_CONST_PARAMS can be used to force fixed values of
  * parameters m and t; thus allowing extra compiler optimizations and providing
  * better (up to 2x) encoding performance. Using this option makes sense when
  * (m,t) are fixed and known in advance, e.g. when using BCH error correction
  * on a particular NAND flash device.
  *
+ * Option CONFIG_BCH_CONST_TABLES can be used together with
+ * CONFIG_BCH_CONST_PARAMS to compile lookup tables as const data instead of
+ * building them at runtime; init_bch() then only allocates its work buffers.
+ * Tables are read from header file bch_const_tables.h, which is generated by
+ * host tool gen_bch_tables (see lib/gen_bch_tables.c) for the same (m,t).
+ *
+ * Option CONFIG_BCH_MAX_M sets the largest supported value of m, which is 16
+ * by default, or the value of CONFIG_BCH_CONST_M if CONFIG_BCH_CONST_PARAMS is
+ * set. Values up to 20 (e.g. m=17 for 8 KB sectors) require setting it
+ * explicitly: Galois field lookup tables then use 32-bit instead of 16-bit
+ * entries for all values of m, which doubles their cache footprint.
+ *
+ * Option CONFIG_BCH_SPEC_LIST can be used instead of CONFIG_BCH_CONST_PARAMS
+ * when several (m,t) pairs are used by the same system. It is defined as a
+ * list of BCH_SPEC(m,t) entries, e.g. "BCH_SPEC(13,4) BCH_SPEC(13,8)", and
+ * each entry requires a specialised variant of the encoder/decoder built by
+ * compiling lib/bch_spec.c with -DBCH_SPEC_M=m -DBCH_SPEC_T=t.
+ *
+ * Similarly, option CONFIG_BCH_ISA_LIST is a list of BCH_ISA(isa) entries, each
+ * requiring a variant built for instruction set level isa (e.g. x86_64_v3) by
+ * compiling lib/bch_spec.c with -DBCH_SPEC_ISA=isa and matching compiler flags.
+ * Instruction set variants are userspace only.
+ *
+ * init_bch() binds each instance to the first usable variant: a (m,t) variant
+ * for the same parameters, then the first instruction set variant supported by
+ * the cpu, in list order. Other instances use the generic code. The selected
+ * variant can be queried with bch_get_kernel(), and forced with
+ * bch_set_kernel() or with environment variable BCH_KERNEL in userspace.
+ *
+ * Option CONFIG_BCH_STATS enables per-instance decoding statistics: cycles
+ * spent in each decoding stage, a histogram of corrected error counts, failure
+ * counts and root finding methods, read with bch_get_stats(). Without this
+ * option, instrumentation is compiled out.
+ *
+ * Option CONFIG_BCH_USDT places userspace statically defined tracepoints
+ * (<sys/sdt.h> probes of provider "bch") at encoding and decoding stage
+ * boundaries, for use with tools such as bpftrace or perf:
+ *
+ *   encode_start(m, t, len), encode_done(m, t)
+ *   decode_start(m, t, len), decode_done(m, t, len, ret)
+ *   syndromes_start(m, t), syndromes_done(m, t)
+ *   elp_start(m, t), elp_done(m, t, err)
+ *   roots_start(m, t, deg), roots_done(m, t, deg, nroots)
+ *
+ * where ret is the decoding result (error count or negative errno), err is
+ * the error locator polynomial degree (-1 if greater than t), and nroots the
+ * number of roots found. Probes are single nop instructions when no tracer is
+ * attached. Without this option, or in the kernel, they are compiled out.
+ *
  * Algorithmic details:
  *
  * Encoding is performed by processing 32 input bits in parallel, using 4
@@ -71,10 +131,30 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/cache.h>
+#include <linux/mutex.h>
 #include <linux/bitops.h>
 #include <asm/byteorder.h>
 #include <linux/bch.h>
 
+#if defined(CONFIG_BCH_STATS)
+#include <linux/timex.h>
+#endif
+
+#if defined(CONFIG_BCH_USDT) && !defined(__KERNEL__)
+#include <sys/sdt.h>
+#define trace_bch(_name, args...)  STAP_PROBEV(bch, _name, ##args)
+#else
+#define trace_bch(_name, args...)  do {} while (0)
+#endif
+
+#if !defined(__KERNEL__)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
 #if defined(CONFIG_BCH_CONST_PARAMS)
 #define GF_M(_p)               (CONFIG_BCH_CONST_M)
 #define GF_T(_p)               (CONFIG_BCH_CONST_T)
@@ -85,13 +165,109 @@
 #define GF_N(_p)               ((_p)->n)
 #endif
 
+#if defined(CONFIG_BCH_SPEC_LIST) || defined(CONFIG_BCH_ISA_LIST)
+#if defined(CONFIG_BCH_CONST_PARAMS)
+#error "variant lists and CONFIG_BCH_CONST_PARAMS are exclusive"
+#endif
+#define BCH_SPEC_DISPATCH
+#endif
+
+#if (BCH_MAX_M < 5) || (BCH_MAX_M > 20)
+#error "CONFIG_BCH_MAX_M must be in the range 5-20"
+#endif
+
 #define BCH_ECC_WORDS(_p)      DIV_ROUND_UP(GF_M(_p)*GF_T(_p), 32)
 #define BCH_ECC_BYTES(_p)      DIV_ROUND_UP(GF_M(_p)*GF_T(_p), 8)
 
+#if defined(CONFIG_BCH_CONST_TABLES)
+#if !defined(CONFIG_BCH_CONST_PARAMS)
+#error "CONFIG_BCH_CONST_TABLES requires CONFIG_BCH_CONST_PARAMS"
+#endif
+#include "bch_const_tables.h"
+#if (BCH_CONST_TABLES_M != CONFIG_BCH_CONST_M) || \
+	(BCH_CONST_TABLES_T != CONFIG_BCH_CONST_T)
+#error "bch_const_tables.h was generated for different (m,t) parameters"
+#endif
+#endif
+
 #ifndef dbg
 #define dbg(_fmt, args...)     do {} while (0)
 #endif
 
+/*
+ * decoding statistics helpers, empty unless CONFIG_BCH_STATS is set
+ */
+#if defined(CONFIG_BCH_STATS)
+static inline uint64_t stats_clock(void)
+{
+	return get_cycles();
+}
+
+/* account cycles elapsed since *clk to a decoding stage, restart clock */
+static inline void stats_stage(struct bch_control *bch, enum bch_stage stage,
+			       uint64_t *clk)
+{
+	uint64_t now = get_cycles();
+
+	bch->stats.cycles[stage] += now-*clk;
+	*clk = now;
+}
+
+static inline int stats_result(struct bch_control *bch, int ret)
+{
+	if (ret == -EINVAL) {
+		bch->stats.einval++;
+		return ret;
+	}
+	bch->stats.decodes++;
+	if (ret < 0)
+		bch->stats.ebadmsg++;
+	else
+		bch->stats.nerr[(ret < BCH_STATS_NERR_MAX) ? ret :
+				BCH_STATS_NERR_MAX]++;
+	return ret;
+}
+
+static inline void stats_roots(struct bch_control *bch, unsigned int deg)
+{
+#if defined(USE_CHIEN_SEARCH)
+	bch->stats.roots_chien++;
+#else
+	if (deg <= 4)
+		bch->stats.roots_deg[deg-1]++;
+	else
+		bch->stats.roots_btz++;
+#endif
+}
+#else
+static inline uint64_t stats_clock(void)
+{
+	return 0;
+}
+
+static inline void stats_stage(struct bch_control *bch, enum bch_stage stage,
+			       uint64_t *clk)
+{
+}
+
+static inline int stats_result(struct bch_control *bch, int ret)
+{
+	return ret;
+}
+
+static inline void stats_roots(struct bch_control *bch, unsigned int deg)
+{
+}
+#endif
+
+/* terminate a decoding call: fire tracepoint, account result */
+static inline int decode_result(struct bch_control *bch, unsigned int len,
+				int ret)
+{
+	trace_bch(decode_done, GF_M(bch), GF_T(bch), len, ret);
+	return stats_result(bch, ret);
+}
+
 /*
  * represent a polynomial over GF(2^m)
  */
@@ -109,6 +285,88 @@ struct gf_poly_deg1 {
 	unsigned int   c[2];
 };
 
+/*
+ * Galois field tables, shared between instances using the same (m,prim_poly)
+ */
+struct bch_gf_tables {
+	struct bch_gf_tables *next;
+	unsigned int          m;
+	unsigned int          prim_poly;
+	unsigned int          refcount;
+	bch_gf_t             *a_pow_tab;
+	bch_gf_t             *a_log_tab;
+	unsigned int         *xi_tab;
+};
+
+/*
+ * encoding tables, shared between instances using the same (m,t,prim_poly)
+ * and bit order
+ */
+struct bch_enc_tables {
+	struct bch_enc_tables *next;
+	unsigned int           m;
+	unsigned int           t;
+	unsigned int           prim_poly;
+	int                    lsb_first;
+	unsigned int           refcount;
+	unsigned int           ecc_bits;
+	uint32_t              *mod8_tab;
+};
+
+/*
+ * encoder/decoder entry points specialised for a given (m,t) pair, or built
+ * for a given instruction set (m = t = 0), see lib/bch_spec.c
+ */
+struct bch_spec {
+	const char  *name;
+	unsigned int m;
+	unsigned int t;
+	int (*supported)(void);
+	void (*encode)(struct bch_control *bch, const uint8_t *data,
+		       unsigned int len, uint8_t *ecc);
+	int (*decode)(struct bch_control *bch, const uint8_t *data,
+		      unsigned int len, const uint8_t *recv_ecc,
+		      const uint8_t *calc_ecc, const unsigned int *syn,
+		      unsigned int *errloc);
+	int (*decode_batch)(struct bch_control *bch, unsigned int nsect,
+			    const uint8_t * const *data, unsigned int len,
+			    const uint8_t * const *recv_ecc,
+			    unsigned int *errloc, int *nerr);
+};
+
+#if !defined(BCH_SPEC_VARIANT)
+#if !defined(CONFIG_BCH_SPEC_LIST)
+#define CONFIG_BCH_SPEC_LIST
+#endif
+#if !defined(CONFIG_BCH_ISA_LIST) || defined(__KERNEL__)
+#undef CONFIG_BCH_ISA_LIST
+#define CONFIG_BCH_ISA_LIST
+#endif
+
+#define BCH_SPEC(_m, _t) extern const struct bch_spec bch_spec_m##_m##t##_t;
+#define BCH_ISA(_isa)    extern const struct bch_spec bch_spec_##_isa;
+CONFIG_BCH_SPEC_LIST
+CONFIG_BCH_ISA_LIST
+#undef BCH_SPEC
+#undef BCH_ISA
+
+/* available variants in order of preference, NULL terminated */
+#define BCH_SPEC(_m, _t) &bch_spec_m##_m##t##_t,
+#define BCH_ISA(_isa)    &bch_spec_##_isa,
+static const struct bch_spec *const bch_spec_list[] = {
+	CONFIG_BCH_SPEC_LIST
+	CONFIG_BCH_ISA_LIST
+	NULL
+};
+#undef BCH_SPEC
+#undef BCH_ISA
+
+/* registry of shared tables, protected by bch_registry_lock */
+static DEFINE_MUTEX(bch_registry_lock);
+static struct bch_gf_tables *bch_gf_list;
+static struct bch_enc_tables *bch_enc_list;
+#endif
+
 /*
  * same as encode_bch(), but process input data one byte at a time
  */
@@ -195,6 +453,13 @@ void encode_bch(struct bch_control *bch, const uint8_t *data,
 	const uint32_t * const tab3 = tab2 + 256*(l+1);
 	const uint32_t *pdata, *p0, *p1, *p2, *p3;
 
+#if defined(BCH_SPEC_DISPATCH)
+	if (bch->spec) {
+		bch->spec->encode(bch, data, len, ecc);
+		return;
+	}
+#endif
+	trace_bch(encode_start, GF_M(bch), GF_T(bch), len);
 	if (ecc) {
 		/* load ecc parity bytes into internal 32-bit buffer */
 		load_ecc8(bch, bch->ecc_buf, ecc);
@@ -251,9 +516,116 @@ void encode_bch(struct bch_control *bch, const uint8_t *data,
 	/* store ecc parity bytes into original parity buffer */
 	if (ecc)
 		store_ecc8(bch, ecc, bch->ecc_buf);
+	trace_bch(encode_done, GF_M(bch), GF_T(bch));
 }
 EXPORT_SYMBOL_GPL(encode_bch);
 
+#if !defined(BCH_SPEC_VARIANT)
+/*
+ * multiply ecc remainder by X^(8*nbytes) modulo generator polynomial, i.e.
+ * encode nbytes zero bytes
+ */
+static void encode_bch_zeros(struct bch_control *bch, uint32_t *r,
+			     unsigned int nbytes)
+{
+	const unsigned int l = BCH_ECC_WORDS(bch)-1;
+	unsigned int i;
+	uint32_t w;
+	const uint32_t * const tab0 = bch->mod8_tab;
+	const uint32_t * const tab1 = tab0 + 256*(l+1);
+	const uint32_t * const tab2 = tab1 + 256*(l+1);
+	const uint32_t * const tab3 = tab2 + 256*(l+1);
+	const uint32_t *p0, *p1, *p2, *p3;
+
+	for (; nbytes >= 4; nbytes -= 4) {
+		w = r[0];
+		p0 = tab0 + (l+1)*((w >>  0) & 0xff);
+		p1 = tab1 + (l+1)*((w >>  8) & 0xff);
+		p2 = tab2 + (l+1)*((w >> 16) & 0xff);
+		p3 = tab3 + (l+1)*((w >> 24) & 0xff);
+
+		for (i = 0; i < l; i++)
+			r[i] = r[i+1]^p0[i]^p1[i]^p2[i]^p3[i];
+
+		r[l] = p0[l]^p1[l]^p2[l]^p3[l];
+	}
+	while (nbytes--) {
+		p0 = tab0 + (l+1)*(r[0] >> 24);
+
+		for (i = 0; i < l; i++)
+			r[i] = ((r[i] << 8)|(r[i+1] >> 24))^(*p0++);
+
+		r[l] = (r[l] << 8)^(*p0);
+	}
+}
+
+/**
+ * update_ecc_bch - update ecc parity after modifying a range of data bytes
+ * @bch:    BCH control structure
+ * @ecc:    ecc parity of data before modification, updated in place
+ * @len:    data length in bytes
+ * @offset: offset of modified bytes in data
+ * @old_bytes: @n data bytes at @offset before modification
+ * @new_bytes: @n data bytes at @offset after modification
+ * @n:      number of modified bytes
+ *
+ * Returns:
+ *  0 on success, or -EINVAL if invalid parameters were provided
+ *
+ * Since ecc parity is linear, the parity of modified data is the parity of
+ * original data XORed with the parity of the difference between @old_bytes
+ * and @new_bytes, shifted to position @offset. The difference is encoded,
+ * and then shifted by encoding the (@len-@offset-@n) trailing zero bytes;
+ * hence the cost of this function depends on @n and on the distance between
+ * modified bytes and the end of data, rather than on @len.
+ */
+int update_ecc_bch(struct bch_control *bch, uint8_t *ecc, unsigned int len,
+		   unsigned int offset, const uint8_t *old_bytes,
+		   const uint8_t *new_bytes, unsigned int n)
+{
+	const unsigned int ecc_words = BCH_ECC_WORDS(bch);
+	const unsigned int l = ecc_words-1;
+	unsigned int i, j;
+	uint32_t *r = bch->ecc_buf;
+	const uint32_t *p;
+	uint8_t d;
+
+	if ((offset > len) || (n > len-offset) ||
+	    (8*len > (bch->n-bch->ecc_bits)))
+		return -EINVAL;
+
+	/* unmodified leading bytes leave remainder to zero */
+	while (n && (*old_bytes == *new_bytes)) {
+		old_bytes++;
+		new_bytes++;
+		offset++;
+		n--;
+	}
+	if (!n)
+		return 0;
+
+	memset(r, 0, ecc_words*sizeof(*r));
+	for (j = 0; j < n; j++) {
+		d = old_bytes[j]^new_bytes[j];
+		p = bch->mod8_tab + (l+1)*(((r[0] >> 24)^d) & 0xff);
+
+		for (i = 0; i < l; i++)
+			r[i] = ((r[i] << 8)|(r[i+1] >> 24))^(*p++);
+
+		r[l] = (r[l] << 8)^(*p);
+	}
+	encode_bch_zeros(bch, r, len-offset-n);
+
+	load_ecc8(bch, bch->ecc_buf2, ecc);
+	for (i = 0; i < ecc_words; i++)
+		r[i] ^= bch->ecc_buf2[i];
+
+	store_ecc8(bch, ecc, r);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(update_ecc_bch);
+#endif /* !BCH_SPEC_VARIANT */
+
 static inline int modulo(struct bch_control *bch, unsigned int v)
 {
 	const unsigned int n = GF_N(bch);
@@ -332,6 +704,19 @@ static inline int a_ilog(struct bch_control *bch, unsigned int x)
 	return mod_s(bch, GF_N(bch)-bch->a_log_tab[x]);
 }
 
+static inline int lsb_first(struct bch_control *bch)
+{
+	return bch->opts.flags & BCH_OPT_LSB_FIRST;
+}
+
+/* reverse bit order in each byte of a 32-bit word */
+static inline uint32_t bitrev_bytes(uint32_t w)
+{
+	w = ((w >> 1) & 0x55555555)|((w & 0x55555555) << 1);
+	w = ((w >> 2) & 0x33333333)|((w & 0x33333333) << 2);
+	return ((w >> 4) & 0x0f0f0f0f)|((w & 0x0f0f0f0f) << 4);
+}
+
 /*
  * compute 2t syndromes of ecc polynomial, i.e. ecc(a^j) for j=1..2t
  */
@@ -339,12 +724,18 @@ static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 			      unsigned int *syn)
 {
 	int i, j, s;
-	unsigned int m;
+	unsigned int m, k, step;
 	uint32_t poly;
 	const int t = GF_T(bch);
 
+	trace_bch(syndromes_start, GF_M(bch), t);
 	s = bch->ecc_bits;
 
+	/* LSB-first remainder words hold bit-reversed bytes */
+	if (lsb_first(bch))
+		for (i = 0; i < (int)BCH_ECC_WORDS(bch); i++)
+			ecc[i] = bitrev_bytes(ecc[i]);
+
 	/* make sure extra bits in last ecc word are cleared */
 	m = ((unsigned int)s) & 31;
 	if (m)
@@ -357,8 +748,16 @@ static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 		s -= 32;
 		while (poly) {
 			i = deg(poly);
-			for (j = 0; j < 2*t; j += 2)
-				syn[j] ^= a_pow(bch, (j+1)*(i+s));
+			/*
+			 * accumulate exponents (j+1)*(i+s) modulo n, the plain
+			 * product would overflow for large values of m
+			 */
+			k = i+s;
+			step = mod_s(bch, 2*k);
+			for (j = 0; j < 2*t; j += 2) {
+				syn[j] ^= bch->a_pow_tab[k];
+				k = mod_s(bch, k+step);
+			}
 
 			poly ^= (1 << i);
 		}
@@ -367,6 +766,7 @@ static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 	/* v(a^(2j)) = v(a^j)^2 */
 	for (j = 0; j < t; j++)
 		syn[2*j+1] = gf_sqr(bch, syn[j]);
+	trace_bch(syndromes_done, GF_M(bch), t);
 }
 
 static void gf_poly_copy(struct gf_poly *dst, struct gf_poly *src)
@@ -383,8 +783,9 @@ static int compute_error_locator_polynomial(struct bch_control *bch,
 	struct gf_poly *elp = bch->elp;
 	struct gf_poly *pelp = bch->poly_2t[0];
 	struct gf_poly *elp_copy = bch->poly_2t[1];
-	int k, pp = -1;
+	int k, pp = -1, err;
 
+	trace_bch(elp_start, GF_M(bch), t);
 	memset(pelp, 0, GF_POLY_SZ(2*t));
 	memset(elp, 0, GF_POLY_SZ(2*t));
 
@@ -423,7 +824,9 @@ static int compute_error_locator_polynomial(struct bch_control *bch,
 		}
 	}
 	dbg("elp=%s\n", gf_poly_str(elp));
-	return (elp->deg > t) ? -1 : (int)elp->deg;
+	err = (elp->deg > t) ? -1 : (int)elp->deg;
+	trace_bch(elp_done, GF_M(bch), t, err);
+	return err;
 }
 
 /*
@@ -502,6 +905,35 @@ static int solve_linear_system(struct bch_control *bch, unsigned int *rows,
 	return nsol;
 }
 
+/*
+ * solve L(X) = c over GF(2^m), where L is a GF(2)-linear map, given rows[0] = c
+ * and rows[i+1] = L(a^i) for i=0..m-1; rows must hold 32 entries, and entries
+ * above m must be zero
+ */
+static int solve_affine_system(struct bch_control *bch, unsigned int *rows,
+			       unsigned int *roots, int nsol)
+{
+	int j, k;
+	const int m = GF_M(bch);
+	/* transposed matrix size: 16x16 for m < 16, 32x32 otherwise */
+	const int size = (m < 16) ? 16 : 32;
+	unsigned int mask, t;
+
+	/*
+	 * transpose size x size matrix before passing it to linear solver
+	 * warning: this code assumes m < 32
+	 */
+	j = size/2;
+	for (mask = (1u << j)-1; j != 0; j >>= 1, mask ^= (mask << j)) {
+		for (k = 0; k < size; k = (k+j+1) & ~j) {
+			t = ((rows[k] >> j)^rows[k+j]) & mask;
+			rows[k] ^= (t << j);
+			rows[k+j] ^= t;
+		}
+	}
+	return solve_linear_system(bch, rows, roots, nsol);
+}
+
 /*
  * this function builds and solves a linear system for finding roots of a degree
  * 4 affine monic polynomial X^4+aX^2+bX+c over GF(2^m).
@@ -512,7 +944,7 @@ static int find_affine4_roots(struct bch_control *bch, unsigned int a,
 {
 	int i, j, k;
 	const int m = GF_M(bch);
-	unsigned int mask = 0xff, t, rows[16] = {0,};
+	unsigned int rows[32] = {0,};
 
 	j = a_log(bch, b);
 	k = a_log(bch, a);
@@ -526,18 +958,7 @@ static int find_affine4_roots(struct bch_control *bch, unsigned int a,
 		j++;
 		k += 2;
 	}
-	/*
-	 * transpose 16x16 matrix before passing it to linear solver
-	 * warning: this code assumes m < 16
-	 */
-	for (j = 8; j != 0; j >>= 1, mask ^= (mask << j)) {
-		for (k = 0; k < 16; k = (k+j+1) & ~j) {
-			t = ((rows[k] >> j)^rows[k+j]) & mask;
-			rows[k] ^= (t << j);
-			rows[k+j] ^= t;
-		}
-	}
-	return solve_linear_system(bch, rows, roots, 4);
+	return solve_affine_system(bch, rows, roots, 4);
 }
 
 /*
@@ -916,7 +1337,7 @@ static int chien_search(struct bch_control *bch, unsigned int len,
 			struct gf_poly *p, unsigned int *roots)
 {
 	int m;
-	unsigned int i, j, syn, syn0, count = 0;
+	unsigned int i, j, e, syn, syn0, count = 0;
 	const unsigned int k = 8*len+bch->ecc_bits;
 
 	/* use a log-based representation of polynomial */
@@ -925,11 +1346,12 @@ static int chien_search(struct bch_control *bch, unsigned int len,
 	syn0 = gf_div(bch, p->c[0], p->c[p->deg]);
 
 	for (i = GF_N(bch)-k+1; i <= GF_N(bch); i++) {
-		/* compute elp(a^i) */
-		for (j = 1, syn = syn0; j <= p->deg; j++) {
+		/* compute elp(a^i), with e = j*i mod n */
+		for (j = 1, e = 0, syn = syn0; j <= p->deg; j++) {
+			e = mod_s(bch, e+i);
 			m = bch->cache[j];
 			if (m >= 0)
-				syn ^= a_pow(bch, m+j*i);
+				syn ^= a_pow(bch, m+e);
 		}
 		if (syn == 0) {
 			roots[count++] = GF_N(bch)-i;
@@ -942,6 +1364,85 @@ static int chien_search(struct bch_control *bch, unsigned int len,
 #define find_poly_roots(_p, _k, _elp, _loc) chien_search(_p, len, _elp, _loc)
 #endif /* USE_CHIEN_SEARCH */
 
+/*
+ * convert between error locations (see decode_bch()) and codeword bit
+ * exponents: with nbits the codeword length in bits, codeword bit i (from first
+ * to last) has exponent nbits-1-i, and is located in bit 7-(i%8) of byte i/8 in
+ * MSB-first order, or in bit i%8 in LSB-first order
+ */
+static inline unsigned int errloc_to_exp(struct bch_control *bch,
+					 unsigned int nbits, unsigned int e)
+{
+	if (lsb_first(bch))
+		return nbits-1-e;
+	return nbits-1-((e & ~7)|(7-(e & 7)));
+}
+
+static inline unsigned int exp_to_errloc(struct bch_control *bch,
+					 unsigned int nbits, unsigned int x)
+{
+	x = nbits-1-x;
+	return lsb_first(bch) ? x : (x & ~7)|(7-(x & 7));
+}
+
+/*
+ * XOR received ecc into calculated ecc (ecc_buf), return 0 if they are equal
+ */
+static uint32_t xor_recv_ecc(struct bch_control *bch, const uint8_t *recv_ecc)
+{
+	const unsigned int ecc_words = BCH_ECC_WORDS(bch);
+	unsigned int i;
+	uint32_t sum = 0;
+
+	load_ecc8(bch, bch->ecc_buf2, recv_ecc);
+	for (i = 0; i < ecc_words; i++) {
+		bch->ecc_buf[i] ^= bch->ecc_buf2[i];
+		sum |= bch->ecc_buf[i];
+	}
+	return sum;
+}
+
+/*
+ * find error locations from syndromes, and convert them to bit positions;
+ * account stages and root finding in statistics if account is set
+ */
+static int locate_errors(struct bch_control *bch, unsigned int len,
+			 const unsigned int *syn, unsigned int *errloc,
+			 int account)
+{
+	unsigned int nbits;
+	int i, err, nroots;
+	uint64_t clk = stats_clock();
+
+	err = compute_error_locator_polynomial(bch, syn);
+	if (account)
+		stats_stage(bch, BCH_STAGE_ELP, &clk);
+	if (err > 0) {
+		/* find_poly_roots() is recursive, trace the outermost call */
+		trace_bch(roots_start, GF_M(bch), GF_T(bch), err);
+		if (account)
+			stats_roots(bch, bch->elp->deg);
+		nroots = find_poly_roots(bch, 1, bch->elp, errloc);
+		if (account)
+			stats_stage(bch, BCH_STAGE_ROOTS, &clk);
+		trace_bch(roots_done, GF_M(bch), GF_T(bch), err, nroots);
+		if (err != nroots)
+			err = -1;
+	}
+	if (err > 0) {
+		/* post-process raw error locations for easier correction */
+		nbits = (len*8)+bch->ecc_bits;
+		for (i = 0; i < err; i++) {
+			if (errloc[i] >= nbits) {
+				err = -1;
+				break;
+			}
+			errloc[i] = exp_to_errloc(bch, nbits, errloc[i]);
+		}
+	}
+	return (err >= 0) ? err : -EBADMSG;
+}
+
 /**
  * decode_bch - decode received codeword and find bit error locations
  * @bch:      BCH control structure
@@ -980,6 +1481,7 @@ static int chien_search(struct bch_control *bch, unsigned int len,
  *
  * if (errloc[n] < 8*len), then n-th error is located in data and can be
  * corrected with statement data[errloc[n]/8] ^= 1 << (errloc[n] % 8);
+ * this holds for both MSB-first and LSB-first instances.
  *
  * Note that this function does not perform any data correction by itself, it
  * merely indicates error locations.
@@ -988,110 +1490,595 @@ int decode_bch(struct bch_control *bch, const uint8_t *data, unsigned int len,
 	       const uint8_t *recv_ecc, const uint8_t *calc_ecc,
 	       const unsigned int *syn, unsigned int *errloc)
 {
-	const unsigned int ecc_words = BCH_ECC_WORDS(bch);
-	unsigned int nbits;
-	int i, err, nroots;
-	uint32_t sum;
+	uint64_t clk;
+
+#if defined(BCH_SPEC_DISPATCH)
+	if (bch->spec)
+		return bch->spec->decode(bch, data, len, recv_ecc, calc_ecc,
+					 syn, errloc);
+#endif
+	trace_bch(decode_start, GF_M(bch), GF_T(bch), len);
+	clk = stats_clock();
 
 	/* sanity check: make sure data length can be handled */
 	if (8*len > (bch->n-bch->ecc_bits))
-		return -EINVAL;
+		return decode_result(bch, len, -EINVAL);
 
 	/* if caller does not provide syndromes, compute them */
 	if (!syn) {
 		if (!calc_ecc) {
 			/* compute received data ecc into an internal buffer */
 			if (!data || !recv_ecc)
-				return -EINVAL;
+				return decode_result(bch, len, -EINVAL);
 			encode_bch(bch, data, len, NULL);
 		} else {
 			/* load provided calculated ecc */
 			load_ecc8(bch, bch->ecc_buf, calc_ecc);
 		}
 		/* load received ecc or assume it was XORed in calc_ecc */
-		if (recv_ecc) {
-			load_ecc8(bch, bch->ecc_buf2, recv_ecc);
-			/* XOR received and calculated ecc */
-			for (i = 0, sum = 0; i < (int)ecc_words; i++) {
-				bch->ecc_buf[i] ^= bch->ecc_buf2[i];
-				sum |= bch->ecc_buf[i];
-			}
-			if (!sum)
-				/* no error found */
-				return 0;
+		if (recv_ecc && !xor_recv_ecc(bch, recv_ecc)) {
+			/* no error found */
+			stats_stage(bch, BCH_STAGE_ECC, &clk);
+			return decode_result(bch, len, 0);
 		}
+		stats_stage(bch, BCH_STAGE_ECC, &clk);
 		compute_syndromes(bch, bch->ecc_buf, bch->syn);
+		stats_stage(bch, BCH_STAGE_SYNDROMES, &clk);
 		syn = bch->syn;
 	}
-
-	err = compute_error_locator_polynomial(bch, syn);
-	if (err > 0) {
-		nroots = find_poly_roots(bch, 1, bch->elp, errloc);
-		if (err != nroots)
-			err = -1;
-	}
-	if (err > 0) {
-		/* post-process raw error locations for easier correction */
-		nbits = (len*8)+bch->ecc_bits;
-		for (i = 0; i < err; i++) {
-			if (errloc[i] >= nbits) {
-				err = -1;
-				break;
-			}
-			errloc[i] = nbits-1-errloc[i];
-			errloc[i] = (errloc[i] & ~7)|(7-(errloc[i] & 7));
-		}
-	}
-	return (err >= 0) ? err : -EBADMSG;
+	return decode_result(bch, len, locate_errors(bch, len, syn, errloc,
+						     1));
 }
 EXPORT_SYMBOL_GPL(decode_bch);
 
-/*
- * generate Galois field lookup tables
+/**
+ * decode_bch_batch - decode a batch of sectors and find bit error locations
+ * @bch:      BCH control structure
+ * @nsect:    number of sectors
+ * @data:     array of @nsect pointers to received data
+ * @len:      data length of each sector in bytes
+ * @recv_ecc: array of @nsect pointers to received ecc
+ * @errloc:   output array of @nsect*t error locations
+ * @nerr:     output array of @nsect per-sector results
+ *
+ * Returns:
+ *  The number of sectors that could not be decoded, or -EINVAL if invalid
+ *  parameters were provided
+ *
+ * This function is equivalent to calling decode_bch(@bch, @data[i], @len,
+ * @recv_ecc[i], NULL, NULL, @errloc+i*t) for each sector i of a page, and
+ * storing the result into @nerr[i] (number of errors found, or -EBADMSG).
+ * Parameters are checked only once, and each sector is screened by comparing
+ * its computed and received ecc: syndrome computation, error locator
+ * polynomial and root finding stages only run on sectors with errors.
+ *
+ * Error locations of sector i are stored in @errloc[i*t] to @errloc[i*t+
+ * @nerr[i]-1] and should be interpreted as described in decode_bch().
  */
-static int build_gf_tables(struct bch_control *bch, unsigned int poly)
+int decode_bch_batch(struct bch_control *bch, unsigned int nsect,
+		     const uint8_t * const *data, unsigned int len,
+		     const uint8_t * const *recv_ecc, unsigned int *errloc,
+		     int *nerr)
 {
-	unsigned int i, x = 1;
-	const unsigned int k = 1 << deg(poly);
+	const unsigned int t = GF_T(bch);
+	unsigned int i;
+	int failed = 0;
+	uint64_t clk;
 
-	/* primitive polynomial must be of degree m */
-	if (k != (1u << GF_M(bch)))
-		return -1;
+#if defined(BCH_SPEC_DISPATCH)
+	if (bch->spec)
+		return bch->spec->decode_batch(bch, nsect, data, len, recv_ecc,
+					       errloc, nerr);
+#endif
+	/* sanity check: make sure data length can be handled */
+	if ((8*len > (bch->n-bch->ecc_bits)) || !data || !recv_ecc ||
+	    !errloc || !nerr) {
+		/* keep decode_start/decode_done pairs balanced */
+		trace_bch(decode_start, GF_M(bch), GF_T(bch), len);
+		return decode_result(bch, len, -EINVAL);
+	}
 
-	for (i = 0; i < GF_N(bch); i++) {
-		bch->a_pow_tab[i] = x;
-		bch->a_log_tab[x] = i;
-		if (i && (x == 1))
-			/* polynomial is not primitive (a^i=1 with 0<i<2^m-1) */
+	for (i = 0; i < nsect; i++) {
+		trace_bch(decode_start, GF_M(bch), GF_T(bch), len);
+		clk = stats_clock();
+		/* screen sector: calc_ecc == recv_ecc means no error */
+		encode_bch(bch, data[i], len, NULL);
+		if (!xor_recv_ecc(bch, recv_ecc[i])) {
+			stats_stage(bch, BCH_STAGE_ECC, &clk);
+			nerr[i] = decode_result(bch, len, 0);
+			continue;
+		}
+		stats_stage(bch, BCH_STAGE_ECC, &clk);
+		compute_syndromes(bch, bch->ecc_buf, bch->syn);
+		stats_stage(bch, BCH_STAGE_SYNDROMES, &clk);
+		nerr[i] = decode_result(bch, len,
+					locate_errors(bch, len, bch->syn,
+						      errloc+i*t, 1));
+		if (nerr[i] < 0)
+			failed++;
+	}
+	return failed;
+}
+EXPORT_SYMBOL_GPL(decode_bch_batch);
+
+#if !defined(BCH_SPEC_VARIANT)
+/**
+ * decode_bch_fix - decode received codeword and group errors by byte
+ * @bch:      BCH control structure
+ * @data:     received data, ignored if @calc_ecc is provided
+ * @len:      data length in bytes, must always be provided
+ * @recv_ecc: received ecc, if NULL then assume it was XORed in @calc_ecc
+ * @calc_ecc: calculated ecc, if NULL then calc_ecc is computed from @data
+ * @syn:      hw computed syndrome data (if NULL, syndrome is calculated)
+ * @fix:      output array of at least t byte corrections
+ *
+ * Returns:
+ *  The number of corrupted bytes found, or -EBADMSG if decoding failed, or
+ *  -EINVAL if invalid parameters were provided
+ *
+ * This function takes the same parameters as decode_bch(), but instead of
+ * bit error locations it returns one (@offset, @mask) entry per corrupted
+ * byte, sorted by increasing offset. Bytes located in data are corrected with
+ * data[@offset] ^= @mask, and bytes located in ecc (@offset >= @len) with
+ * ecc[@offset-@len] ^= @mask.
+ */
+int decode_bch_fix(struct bch_control *bch, const uint8_t *data,
+		   unsigned int len, const uint8_t *recv_ecc,
+		   const uint8_t *calc_ecc, const unsigned int *syn,
+		   struct bch_fix *fix)
+{
+	int i, j, k, nerr;
+	unsigned int offset;
+	uint8_t mask;
+
+	nerr = decode_bch(bch, data, len, recv_ecc, calc_ecc, syn,
+			  bch->errloc);
+	if (nerr <= 0)
+		return nerr;
+
+	/* insertion sort of at most t entries, merging bits of a same byte */
+	for (i = 0, k = 0; i < nerr; i++) {
+		offset = bch->errloc[i]/8;
+		mask = 1 << (bch->errloc[i] & 7);
+		for (j = k; (j > 0) && (fix[j-1].offset > offset); j--)
+			;
+		if ((j > 0) && (fix[j-1].offset == offset)) {
+			fix[j-1].mask |= mask;
+			continue;
+		}
+		memmove(&fix[j+1], &fix[j], (k-j)*sizeof(*fix));
+		fix[j].offset = offset;
+		fix[j].mask = mask;
+		k++;
+	}
+	return k;
+}
+EXPORT_SYMBOL_GPL(decode_bch_fix);
+
+/**
+ * correct_bch - decode received codeword and correct it in place
+ * @bch:      BCH control structure
+ * @data:     received data, corrected in place
+ * @len:      data length in bytes
+ * @ecc:      received ecc, corrected in place
+ *
+ * Returns:
+ *  The number of corrected bit errors, or -EBADMSG if decoding failed (in
+ *  which case @data and @ecc are left untouched), or -EINVAL if invalid
+ *  parameters were provided
+ */
+int correct_bch(struct bch_control *bch, uint8_t *data, unsigned int len,
+		uint8_t *ecc)
+{
+	int i, nerr;
+	unsigned int e;
+
+	nerr = decode_bch(bch, data, len, ecc, NULL, NULL, bch->errloc);
+
+	for (i = 0; i < nerr; i++) {
+		e = bch->errloc[i];
+		if (e < 8*len)
+			data[e/8] ^= 1 << (e & 7);
+		else
+			ecc[e/8-len] ^= 1 << (e & 7);
+	}
+	return nerr;
+}
+EXPORT_SYMBOL_GPL(correct_bch);
+
+/*
+ * update syndromes S(j) = v(a^j), j=1..2t after flipping codeword bit with
+ * exponent x: since syndromes are linear, S(j) ^= a^(j*x)
+ */
+static void update_syndromes(struct bch_control *bch, unsigned int *syn,
+			     unsigned int x)
+{
+	const unsigned int t = GF_T(bch);
+	unsigned int j, k = x;
+
+	for (j = 0; j < 2*t; j++) {
+		syn[j] ^= bch->a_pow_tab[k];
+		k = mod_s(bch, k+x);
+	}
+}
+
+/*
+ * check if location e is flipped by test pattern mask
+ */
+static int is_test_bit(const unsigned int *lrb, unsigned int nlrb,
+		       unsigned int mask, unsigned int e)
+{
+	unsigned int i;
+
+	for (i = 0; i < nlrb; i++)
+		if ((mask & (1u << i)) && (lrb[i] == e))
+			return 1;
+	return 0;
+}
+
+/**
+ * compute_syndromes_bch - compute syndromes of a received codeword
+ * @bch:      BCH control structure
+ * @data:     received data
+ * @len:      data length in bytes
+ * @recv_ecc: received ecc
+ * @syn:      output array of 2t syndromes
+ *
+ * Returns:
+ *  0 on success, or -EINVAL if invalid parameters were provided
+ *
+ * Syndromes computed by this function can be updated with
+ * update_syndromes_bch() and passed to decode_bch() as @syn parameter.
+ */
+int compute_syndromes_bch(struct bch_control *bch, const uint8_t *data,
+			  unsigned int len, const uint8_t *recv_ecc,
+			  unsigned int *syn)
+{
+	if ((8*len > (bch->n-bch->ecc_bits)) || !data || !recv_ecc || !syn)
+		return -EINVAL;
+
+	encode_bch(bch, data, len, NULL);
+	if (xor_recv_ecc(bch, recv_ecc))
+		compute_syndromes(bch, bch->ecc_buf, syn);
+	else
+		memset(syn, 0, 2*GF_T(bch)*sizeof(*syn));
+	return 0;
+}
+EXPORT_SYMBOL_GPL(compute_syndromes_bch);
+
+/*
+ * update odd syndromes S(2j+1) with all set bits of byte diff at errloc
+ * 8*offset
+ */
+static void update_odd_syndromes(struct bch_control *bch, unsigned int *syn,
+				 unsigned int nbits, unsigned int offset,
+				 unsigned int diff)
+{
+	const unsigned int t = GF_T(bch);
+	unsigned int b, j, k, x, step;
+
+	while (diff) {
+		b = __ffs(diff);
+		diff &= diff-1;
+		x = errloc_to_exp(bch, nbits, 8*offset+b);
+		/* skip padding bits of last ecc byte */
+		if (x >= nbits)
+			continue;
+		k = x;
+		step = mod_s(bch, 2*x);
+		for (j = 0; j < 2*t; j += 2) {
+			syn[j] ^= bch->a_pow_tab[k];
+			k = mod_s(bch, k+step);
+		}
+	}
+}
+
+/**
+ * update_syndromes_bch - update syndromes after a codeword has been re-read
+ * @bch:      BCH control structure
+ * @syn:      syndromes of @old_data and @old_ecc, updated in place
+ * @len:      data length in bytes
+ * @old_data: previously received data
+ * @new_data: newly received data
+ * @old_ecc:  previously received ecc, may be NULL if ecc did not change
+ * @new_ecc:  newly received ecc, may be NULL if ecc did not change
+ *
+ * Returns:
+ *  The number of bits that differ between old and new buffers, or -EINVAL if
+ *  invalid parameters were provided
+ *
+ * Since syndromes are linear, syndromes of a re-read codeword (e.g. during
+ * NAND read-retry) can be obtained by updating the syndromes of a previous
+ * read with the bits that changed between both reads. Apart from comparing
+ * buffers, the cost of this function is proportional to the number of changed
+ * bits rather than to the codeword size. The updated syndromes can be passed
+ * to decode_bch():
+ *
+ *   compute_syndromes_bch(@bch, @old_data, @len, @old_ecc, @syn);
+ *   decode_bch(@bch, NULL, @len, NULL, NULL, @syn, @errloc);
+ *   ...read-retry...
+ *   update_syndromes_bch(@bch, @syn, @len, @old_data, @new_data, @old_ecc,
+ *                        @new_ecc);
+ *   decode_bch(@bch, NULL, @len, NULL, NULL, @syn, @errloc);
+ */
+int update_syndromes_bch(struct bch_control *bch, unsigned int *syn,
+			 unsigned int len, const uint8_t *old_data,
+			 const uint8_t *new_data, const uint8_t *old_ecc,
+			 const uint8_t *new_ecc)
+{
+	const unsigned int t = GF_T(bch);
+	const unsigned int nbits = 8*len+bch->ecc_bits;
+	unsigned int i, j, diff, nflips = 0;
+	unsigned long w1, w2;
+
+	if ((8*len > (bch->n-bch->ecc_bits)) || !syn || !old_data ||
+	    !new_data)
+		return -EINVAL;
+
+	/* skip identical words quickly */
+	for (i = 0; i < len; i += j) {
+		j = sizeof(w1);
+		if (i+j <= len) {
+			memcpy(&w1, old_data+i, j);
+			memcpy(&w2, new_data+i, j);
+			if (w1 == w2)
+				continue;
+		}
+		for (j = 0; (j < sizeof(w1)) && (i+j < len); j++) {
+			diff = old_data[i+j]^new_data[i+j];
+			if (diff) {
+				nflips += hweight32(diff);
+				update_odd_syndromes(bch, syn, nbits, i+j,
+						     diff);
+			}
+		}
+	}
+
+	if (old_ecc && new_ecc) {
+		for (i = 0; i < bch->ecc_bytes; i++) {
+			diff = old_ecc[i]^new_ecc[i];
+			if (diff) {
+				nflips += hweight32(diff);
+				update_odd_syndromes(bch, syn, nbits, len+i,
+						     diff);
+			}
+		}
+	}
+
+	/* S(2j) = S(j)^2 */
+	if (nflips)
+		for (j = 0; j < t; j++)
+			syn[2*j+1] = gf_sqr(bch, syn[j]);
+
+	return nflips;
+}
+EXPORT_SYMBOL_GPL(update_syndromes_bch);
+
+/*
+ * check that flipping bits listed in bch->errloc cancels syndromes; beyond t
+ * errors, an error locator polynomial may have deg <= t distinct roots without
+ * yielding a codeword
+ */
+static int is_codeword(struct bch_control *bch, unsigned int nbits, int nerr)
+{
+	const unsigned int t = GF_T(bch);
+	unsigned int i, sum = 0;
+
+	for (i = 0; i < (unsigned int)nerr; i++)
+		update_syndromes(bch, bch->syn,
+				 errloc_to_exp(bch, nbits, bch->errloc[i]));
+
+	for (i = 0; i < 2*t; i++)
+		sum |= bch->syn[i];
+
+	/* restore syndromes */
+	for (i = 0; i < (unsigned int)nerr; i++)
+		update_syndromes(bch, bch->syn,
+				 errloc_to_exp(bch, nbits, bch->errloc[i]));
+	return !sum;
+}
+
+/**
+ * decode_bch_soft - decode received codeword using unreliable bit hints
+ * @bch:      BCH control structure
+ * @data:     received data
+ * @len:      data length in bytes
+ * @recv_ecc: received ecc
+ * @lrb:      least reliable bit locations, least reliable first
+ * @nlrb:     number of locations in @lrb
+ * @errloc:   output array of at least t+@nlrb error locations
+ *
+ * Returns:
+ *  The number of errors found, or -EBADMSG if decoding failed, or -EINVAL if
+ *  invalid parameters were provided
+ *
+ * This function implements Chase-II decoding: if hard decoding fails, it tries
+ * to decode the received word after flipping each nonempty subset (test
+ * pattern) of the first BCH_SOFT_MAX_LRB least reliable bits, and keeps the
+ * candidate codeword closest to the received word. Test patterns are
+ * enumerated in Gray code order, so that each trial flips a single bit and
+ * only updates syndromes, without re-encoding data. Enumeration stops early
+ * if a candidate at distance t+1 is found; otherwise, 2^@nlrb-1 trials are
+ * performed, which should be taken into account when choosing @nlrb.
+ *
+ * Locations in @lrb and @errloc follow decode_bch() conventions: bit
+ * location l designates bit (l % 8) of byte (l / 8) in data followed by ecc.
+ * Locations in @lrb must be distinct.
+ *
+ * Each call is accounted as a single decode in statistics; only the hard
+ * decoding attempt contributes to stage cycles and root finding counts.
+ */
+int decode_bch_soft(struct bch_control *bch, const uint8_t *data,
+		    unsigned int len, const uint8_t *recv_ecc,
+		    const unsigned int *lrb, unsigned int nlrb,
+		    unsigned int *errloc)
+{
+	const unsigned int t = GF_T(bch);
+	const unsigned int nbits = 8*len+bch->ecc_bits;
+	unsigned int i, j, k, mask, weight, best = ~0u;
+	unsigned int x[BCH_SOFT_MAX_LRB];
+	int nerr, err;
+	uint64_t clk;
+
+	trace_bch(decode_start, GF_M(bch), GF_T(bch), len);
+	clk = stats_clock();
+
+	if ((8*len > (bch->n-bch->ecc_bits)) || !data || !recv_ecc ||
+	    (nlrb && !lrb))
+		return decode_result(bch, len, -EINVAL);
+
+	if (nlrb > BCH_SOFT_MAX_LRB)
+		nlrb = BCH_SOFT_MAX_LRB;
+
+	for (i = 0; i < nlrb; i++) {
+		if (errloc_to_exp(bch, nbits, lrb[i]) >= nbits)
+			return decode_result(bch, len, -EINVAL);
+		x[i] = errloc_to_exp(bch, nbits, lrb[i]);
+	}
+
+	encode_bch(bch, data, len, NULL);
+	if (!xor_recv_ecc(bch, recv_ecc)) {
+		stats_stage(bch, BCH_STAGE_ECC, &clk);
+		return decode_result(bch, len, 0);
+	}
+	stats_stage(bch, BCH_STAGE_ECC, &clk);
+	compute_syndromes(bch, bch->ecc_buf, bch->syn);
+	stats_stage(bch, BCH_STAGE_SYNDROMES, &clk);
+	nerr = locate_errors(bch, len, bch->syn, bch->errloc, 1);
+	if ((nerr >= 0) && is_codeword(bch, nbits, nerr)) {
+		memcpy(errloc, bch->errloc, nerr*sizeof(*errloc));
+		return decode_result(bch, len, nerr);
+	}
+	nerr = -EBADMSG;
+
+	/* enumerate test patterns in Gray code order */
+	for (k = 1, mask = 0; k < (1u << nlrb); k++) {
+		j = __ffs(k);
+		mask ^= 1u << j;
+		update_syndromes(bch, bch->syn, x[j]);
+
+		/* trials are not accounted in root finding statistics */
+		err = locate_errors(bch, len, bch->syn, bch->errloc, 0);
+		if (err < 0)
+			continue;
+
+		/* flipped bits: test pattern xor decoded errors */
+		weight = hweight32(mask)+err;
+		for (i = 0; i < (unsigned int)err; i++)
+			if (is_test_bit(lrb, nlrb, mask, bch->errloc[i]))
+				weight -= 2;
+
+		if ((weight >= best) || !is_codeword(bch, nbits, err))
+			continue;
+
+		best = weight;
+		for (i = 0, nerr = 0; i < (unsigned int)err; i++)
+			if (!is_test_bit(lrb, nlrb, mask, bch->errloc[i]))
+				errloc[nerr++] = bch->errloc[i];
+
+		for (i = 0; i < nlrb; i++) {
+			if (!(mask & (1u << i)))
+				continue;
+			for (j = 0; j < (unsigned int)err; j++)
+				if (bch->errloc[j] == lrb[i])
+					break;
+			if (j == (unsigned int)err)
+				errloc[nerr++] = lrb[i];
+		}
+		/* hard decoding failed, no candidate can do better */
+		if (best <= t+1)
+			break;
+	}
+	return decode_result(bch, len, nerr);
+}
+EXPORT_SYMBOL_GPL(decode_bch_soft);
+
+/*
+ * generate Galois field lookup tables
+ */
+static int build_gf_tables(struct bch_control *bch, struct bch_gf_tables *gf)
+{
+	unsigned int i, x = 1;
+	const unsigned int poly = gf->prim_poly;
+	const unsigned int k = 1 << deg(poly);
+
+	/* primitive polynomial must be of degree m */
+	if (k != (1u << GF_M(bch)))
+		return -1;
+
+	for (i = 0; i < GF_N(bch); i++) {
+		gf->a_pow_tab[i] = x;
+		gf->a_log_tab[x] = i;
+		if (i && (x == 1))
+			/* polynomial is not primitive (a^i=1 with 0<i<2^m-1) */
 			return -1;
 		x <<= 1;
 		if (x & k)
 			x ^= poly;
 	}
-	bch->a_pow_tab[GF_N(bch)] = 1;
-	bch->a_log_tab[0] = 0;
+	gf->a_pow_tab[GF_N(bch)] = 1;
+	gf->a_log_tab[0] = 0;
 
 	return 0;
 }
 
+/*
+ * convert remainder tables to LSB-first bit order: since bit reversal within
+ * bytes commutes with xor and byte shifts, encoding LSB-first data with
+ * tables T'[i] = bitrev(T[bitrev(i)]) yields a bit-reversed remainder, which
+ * is the LSB-first ecc, without reversing any data bit
+ */
+static void lsb_mod8_tables(uint32_t *mod8_tab, int l)
+{
+	int i, j, r;
+	uint32_t tmp, *tab, *rtab;
+
+	for (i = 0; i < 4*256; i++) {
+		r = (i & ~0xff)|(bitrev_bytes(i) & 0xff);
+		if (r < i)
+			continue;
+		tab = mod8_tab+i*l;
+		rtab = mod8_tab+r*l;
+		for (j = 0; j < l; j++) {
+			tmp = bitrev_bytes(tab[j]);
+			tab[j] = bitrev_bytes(rtab[j]);
+			rtab[j] = tmp;
+		}
+	}
+}
+
 /*
  * compute generator polynomial remainder tables for fast encoding
  */
-static void build_mod8_tables(struct bch_control *bch, const uint32_t *g)
+static void build_mod8_tables(struct bch_control *bch,
+			      struct bch_enc_tables *enc, const uint32_t *g)
 {
 	int i, j, b, d;
 	uint32_t data, hi, lo, *tab;
+	const uint32_t *p1, *p2;
 	const int l = BCH_ECC_WORDS(bch);
 	const int plen = DIV_ROUND_UP(bch->ecc_bits+1, 32);
 	const int ecclen = DIV_ROUND_UP(bch->ecc_bits, 32);
 
-	memset(bch->mod8_tab, 0, 4*256*l*sizeof(*bch->mod8_tab));
-
-	for (i = 0; i < 256; i++) {
-		/* p(X)=i is a small polynomial of weight <= 8 */
-		for (b = 0; b < 4; b++) {
+	memset(enc->mod8_tab, 0, 4*256*l*sizeof(*enc->mod8_tab));
+
+	for (b = 0; b < 4; b++) {
+		for (i = 1; i < 256; i++) {
+			/* p(X)=i is a small polynomial of weight <= 8 */
+			tab = enc->mod8_tab + (b*256+i)*l;
+			if (i & (i-1)) {
+				/*
+				 * split p(X) into p1(X)+p2(X), both already
+				 * processed, and use (p1+p2) mod g = p1 mod g +
+				 * p2 mod g
+				 */
+				p1 = enc->mod8_tab + (b*256+(i & (i-1)))*l;
+				p2 = enc->mod8_tab + (b*256+(i & -i))*l;
+				for (j = 0; j < l; j++)
+					tab[j] = p1[j]^p2[j];
+				continue;
+			}
 			/* we want to compute (p(X).X^(8*b+deg(g))) mod g(X) */
-			tab = bch->mod8_tab + (b*256+i)*l;
 			data = i << (8*b);
 			while (data) {
 				d = deg(data);
@@ -1106,47 +2093,51 @@ static void build_mod8_tables(struct bch_control *bch, const uint32_t *g)
 			}
 		}
 	}
+	if (lsb_first(bch))
+		lsb_mod8_tables(enc->mod8_tab, l);
 }
 
 /*
  * build a base for factoring degree 2 polynomials
  */
-static int build_deg2_base(struct bch_control *bch)
+static int build_deg2_base(struct bch_control *bch, struct bch_gf_tables *gf)
 {
 	const int m = GF_M(bch);
-	int i, j, r;
-	unsigned int sum, x, y, remaining, ak = 0, xi[m];
+	int i, j;
+	unsigned int sum, ak = 0, tr[m], rows[32], sol[2];
 
-	/* find k s.t. Tr(a^k) = 1 and 0 <= k < m */
-	for (i = 0; i < m; i++) {
+	/* compute Tr(a^i) for i=0..m-1, and find k s.t. Tr(a^k) = 1 */
+	for (i = m-1; i >= 0; i--) {
 		for (j = 0, sum = 0; j < m; j++)
 			sum ^= a_pow(bch, i*(1 << j));
 
-		if (sum) {
+		tr[i] = sum;
+		if (sum)
 			ak = bch->a_pow_tab[i];
-			break;
-		}
 	}
-	/* find xi, i=0..m-1 such that xi^2+xi = a^i+Tr(a^i).a^k */
-	remaining = m;
-	memset(xi, 0, sizeof(xi));
-
-	for (x = 0; (x <= GF_N(bch)) && remaining; x++) {
-		y = gf_sqr(bch, x)^x;
-		for (i = 0; i < 2; i++) {
-			r = a_log(bch, y);
-			if (y && (r < m) && !xi[r]) {
-				bch->xi_tab[r] = x;
-				xi[r] = 1;
-				remaining--;
-				dbg("x%d = %x\n", r, x);
-				break;
-			}
-			y ^= ak;
-		}
+	if (!ak)
+		/* should not happen but check anyway */
+		return -1;
+
+	/*
+	 * find xi, i=0..m-1 such that xi^2+xi = a^i+Tr(a^i).a^k, by solving
+	 * the linear system L(x) = x^2+x = a^i+Tr(a^i).a^k; since
+	 * Tr(a^i+Tr(a^i).a^k) = 0, it has exactly 2 solutions x and x+1
+	 */
+	for (i = 0; i < m; i++) {
+		memset(rows, 0, sizeof(rows));
+		rows[0] = bch->a_pow_tab[i]^(tr[i] ? ak : 0);
+		for (j = 0; j < m; j++)
+			rows[j+1] = bch->a_pow_tab[2*j]^bch->a_pow_tab[j];
+
+		if (solve_affine_system(bch, rows, sol, 2) != 2)
+			/* should not happen but check anyway */
+			return -1;
+
+		gf->xi_tab[i] = sol[0];
+		dbg("x%d = %x\n", i, sol[0]);
 	}
-	/* should not happen but check anyway */
-	return remaining ? -1 : 0;
+	return 0;
 }
 
 static void *bch_alloc(size_t size, int *err)
@@ -1166,69 +2157,498 @@ static uint32_t *compute_generator_polynomial(struct bch_control *bch)
 {
 	const unsigned int m = GF_M(bch);
 	const unsigned int t = GF_T(bch);
+	const unsigned int words = DIV_ROUND_UP(m*t+1, 32);
 	int n, err = 0;
-	unsigned int i, j, nbits, r, word, *roots;
-	struct gf_poly *g;
-	uint32_t *genpoly;
+	unsigned int i, j, k, w, nbits, r, word, mbits, gdeg;
+	struct gf_poly *mp;
+	uint32_t *g, *tmp, *genpoly;
 
-	g = bch_alloc(GF_POLY_SZ(m*t), &err);
-	roots = bch_alloc((bch->n+1)*sizeof(*roots), &err);
-	genpoly = bch_alloc(DIV_ROUND_UP(m*t+1, 32)*sizeof(*genpoly), &err);
+	mp = bch_alloc(GF_POLY_SZ(m), &err);
+	g = bch_alloc(words*sizeof(*g), &err);
+	tmp = bch_alloc(words*sizeof(*tmp), &err);
+	genpoly = bch_alloc(words*sizeof(*genpoly), &err);
 
-	if (err) {
-		kfree(genpoly);
-		genpoly = NULL;
-		goto finish;
-	}
+	if (err)
+		goto fail;
 
-	/* enumerate all roots of g(X) */
-	memset(roots , 0, (bch->n+1)*sizeof(*roots));
-	for (i = 0; i < t; i++) {
-		for (j = 0, r = 2*i+1; j < m; j++) {
-			roots[r] = 1;
+	/*
+	 * g(X) is the product of the minimal polynomials of a^i, i=1,3..2t-1;
+	 * those have binary coefficients, so that g(X) can be built with GF(2)
+	 * polynomial products, stored as bit arrays (bit k = coefficient X^k)
+	 */
+	memset(g, 0, words*sizeof(*g));
+	g[0] = 1;
+	gdeg = 0;
+
+	for (i = 1; i < 2*t; i += 2) {
+		/* skip a^i if its cyclotomic coset was already processed */
+		r = i;
+		do {
 			r = mod_s(bch, 2*r);
+		} while ((r != i) && (r > i));
+
+		if (r != i)
+			continue;
+
+		/* minimal polynomial of a^i: product of (X+a^r), r in coset */
+		mp->deg = 0;
+		mp->c[0] = 1;
+		do {
+			mp->c[mp->deg+1] = 1;
+			for (j = mp->deg; j > 0; j--)
+				mp->c[j] = gf_mul(bch, mp->c[j],
+						  bch->a_pow_tab[r])^mp->c[j-1];
+
+			mp->c[0] = gf_mul(bch, mp->c[0], bch->a_pow_tab[r]);
+			mp->deg++;
+			r = mod_s(bch, 2*r);
+		} while (r != i);
+
+		for (j = 0, mbits = 0; j <= mp->deg; j++) {
+			if (mp->c[j] > 1)
+				/* should not happen but check anyway */
+				goto fail;
+			mbits |= mp->c[j] << j;
 		}
-	}
-	/* build generator polynomial g(X) */
-	g->deg = 0;
-	g->c[0] = 1;
-	for (i = 0; i < GF_N(bch); i++) {
-		if (roots[i]) {
-			/* multiply g(X) by (X+root) */
-			r = bch->a_pow_tab[i];
-			g->c[g->deg+1] = 1;
-			for (j = g->deg; j > 0; j--)
-				g->c[j] = gf_mul(bch, g->c[j], r)^g->c[j-1];
-
-			g->c[0] = gf_mul(bch, g->c[0], r);
-			g->deg++;
+		/* multiply g(X) by minimal polynomial in GF(2)[X] */
+		memset(tmp, 0, words*sizeof(*tmp));
+		for (k = 0; k <= mp->deg; k++) {
+			if (!(mbits & (1u << k)))
+				continue;
+			for (w = 0; w <= gdeg/32; w++) {
+				tmp[w] ^= g[w] << k;
+				if (k && (w+1 < words))
+					tmp[w+1] ^= g[w] >> (32-k);
+			}
 		}
+		memcpy(g, tmp, words*sizeof(*g));
+		gdeg += mp->deg;
 	}
 	/* store left-justified binary representation of g(X) */
-	n = g->deg+1;
+	n = gdeg+1;
 	i = 0;
 
 	while (n > 0) {
 		nbits = (n > 32) ? 32 : n;
 		for (j = 0, word = 0; j < nbits; j++) {
-			if (g->c[n-1-j])
+			k = n-1-j;
+			if (g[k/32] & (1u << (k & 31)))
 				word |= 1u << (31-j);
 		}
 		genpoly[i++] = word;
 		n -= nbits;
 	}
-	bch->ecc_bits = g->deg;
+	bch->ecc_bits = gdeg;
+	goto finish;
 
+fail:
+	kfree(genpoly);
+	genpoly = NULL;
 finish:
+	kfree(mp);
 	kfree(g);
-	kfree(roots);
+	kfree(tmp);
 
 	return genpoly;
 }
 
+static void free_gf_tables(struct bch_gf_tables *gf)
+{
+	if (gf) {
+		kfree(gf->a_pow_tab);
+		kfree(gf->a_log_tab);
+		kfree(gf->xi_tab);
+		kfree(gf);
+	}
+}
+
+/*
+ * get a reference on Galois field tables for (m,prim_poly), building them if
+ * no other instance already uses them
+ */
+static struct bch_gf_tables *get_gf_tables(struct bch_control *bch,
+					   unsigned int prim_poly)
+{
+	int err = 0;
+	struct bch_gf_tables *gf;
+
+	mutex_lock(&bch_registry_lock);
+
+	for (gf = bch_gf_list; gf; gf = gf->next) {
+		if ((gf->m == GF_M(bch)) && (gf->prim_poly == prim_poly)) {
+			gf->refcount++;
+			goto finish;
+		}
+	}
+
+	gf = kzalloc(sizeof(*gf), GFP_KERNEL);
+	if (gf == NULL)
+		goto finish;
+
+	gf->m = GF_M(bch);
+	gf->prim_poly = prim_poly;
+	gf->refcount = 1;
+	gf->a_pow_tab = bch_alloc((1+GF_N(bch))*sizeof(*gf->a_pow_tab), &err);
+	gf->a_log_tab = bch_alloc((1+GF_N(bch))*sizeof(*gf->a_log_tab), &err);
+	gf->xi_tab    = bch_alloc(GF_M(bch)*sizeof(*gf->xi_tab), &err);
+
+	if (err || build_gf_tables(bch, gf))
+		goto fail;
+
+	/* field operations are needed for building the degree 2 base */
+	bch->a_pow_tab = gf->a_pow_tab;
+	bch->a_log_tab = gf->a_log_tab;
+
+	if (build_deg2_base(bch, gf))
+		goto fail;
+
+	gf->next = bch_gf_list;
+	bch_gf_list = gf;
+	goto finish;
+fail:
+	free_gf_tables(gf);
+	gf = NULL;
+finish:
+	mutex_unlock(&bch_registry_lock);
+
+	if (gf) {
+		bch->a_pow_tab = gf->a_pow_tab;
+		bch->a_log_tab = gf->a_log_tab;
+		bch->xi_tab    = gf->xi_tab;
+	}
+	return gf;
+}
+
+static void put_gf_tables(struct bch_gf_tables *gf)
+{
+	struct bch_gf_tables **p;
+
+	if (gf == NULL)
+		return;
+
+	mutex_lock(&bch_registry_lock);
+	if (--gf->refcount == 0) {
+		for (p = &bch_gf_list; *p; p = &(*p)->next) {
+			if (*p == gf) {
+				*p = gf->next;
+				break;
+			}
+		}
+		free_gf_tables(gf);
+	}
+	mutex_unlock(&bch_registry_lock);
+}
+
+static void free_enc_tables(struct bch_enc_tables *enc)
+{
+	if (enc) {
+		kfree(enc->mod8_tab);
+		kfree(enc);
+	}
+}
+
+/*
+ * get a reference on encoding tables for (m,t,prim_poly) and bit order,
+ * building them if no other instance already uses them; field tables must be
+ * available
+ */
+static struct bch_enc_tables *get_enc_tables(struct bch_control *bch,
+					     unsigned int prim_poly)
+{
+	int err = 0;
+	uint32_t *genpoly;
+	struct bch_enc_tables *enc;
+
+	mutex_lock(&bch_registry_lock);
+
+	for (enc = bch_enc_list; enc; enc = enc->next) {
+		if ((enc->m == GF_M(bch)) && (enc->t == GF_T(bch)) &&
+		    (enc->prim_poly == prim_poly) &&
+		    (enc->lsb_first == lsb_first(bch))) {
+			enc->refcount++;
+			goto finish;
+		}
+	}
+
+	enc = kzalloc(sizeof(*enc), GFP_KERNEL);
+	if (enc == NULL)
+		goto finish;
+
+	enc->m = GF_M(bch);
+	enc->t = GF_T(bch);
+	enc->prim_poly = prim_poly;
+	enc->lsb_first = lsb_first(bch);
+	enc->refcount = 1;
+	enc->mod8_tab = bch_alloc(BCH_ECC_WORDS(bch)*1024*
+				  sizeof(*enc->mod8_tab), &err);
+	if (err)
+		goto fail;
+
+	/* use generator polynomial for computing encoding tables */
+	genpoly = compute_generator_polynomial(bch);
+	if (genpoly == NULL)
+		goto fail;
+
+	enc->ecc_bits = bch->ecc_bits;
+	build_mod8_tables(bch, enc, genpoly);
+	kfree(genpoly);
+
+	enc->next = bch_enc_list;
+	bch_enc_list = enc;
+	goto finish;
+fail:
+	free_enc_tables(enc);
+	enc = NULL;
+finish:
+	mutex_unlock(&bch_registry_lock);
+
+	if (enc) {
+		bch->mod8_tab = enc->mod8_tab;
+		bch->ecc_bits = enc->ecc_bits;
+	}
+	return enc;
+}
+
+static void put_enc_tables(struct bch_enc_tables *enc)
+{
+	struct bch_enc_tables **p;
+
+	if (enc == NULL)
+		return;
+
+	mutex_lock(&bch_registry_lock);
+	if (--enc->refcount == 0) {
+		for (p = &bch_enc_list; *p; p = &(*p)->next) {
+			if (*p == enc) {
+				*p = enc->next;
+				break;
+			}
+		}
+		free_enc_tables(enc);
+	}
+	mutex_unlock(&bch_registry_lock);
+}
+
+/*
+ * check that a variant can be used by an instance on this cpu
+ */
+static int check_bch_spec(struct bch_control *bch, const struct bch_spec *spec)
+{
+	if (spec->m && ((spec->m != bch->m) || (spec->t != bch->t)))
+		return -EINVAL;
+
+	if (spec->supported && !spec->supported())
+		return -ENODEV;
+
+	return 0;
+}
+
+/*
+ * bind an instance to the first usable variant, unless overridden
+ */
+static void select_bch_spec(struct bch_control *bch)
+{
+	const struct bch_spec *const *spec;
+#if !defined(__KERNEL__)
+	const char *name = getenv("BCH_KERNEL");
+
+	if (name && !bch_set_kernel(bch, name))
+		return;
+#endif
+	for (spec = bch_spec_list; *spec; spec++) {
+		if (!check_bch_spec(bch, *spec)) {
+			bch->spec = *spec;
+			break;
+		}
+	}
+}
+
+/*
+ * instance memory, carved into cache line aligned buffers
+ */
+struct bch_arena {
+	uint8_t *base;
+	size_t   size;
+};
+
+static void *arena_alloc(struct bch_arena *arena, size_t size)
+{
+	void *ptr = arena->base ? arena->base+arena->size : NULL;
+
+	arena->size += ALIGN(size, L1_CACHE_BYTES);
+	return ptr;
+}
+
+/*
+ * lay out a control structure, its work buffers and, if @gf and @enc are not
+ * NULL, its private lookup tables in an arena; if the arena base is NULL,
+ * only compute the arena size, @bch being a scratch structure
+ */
+static void layout_bch_arena(struct bch_arena *arena, struct bch_control *bch,
+			     int m, int t, struct bch_gf_tables *gf,
+			     struct bch_enc_tables *enc)
+{
+	unsigned int i;
+	const unsigned int words = DIV_ROUND_UP(m*t, 32);
+	const unsigned int n = (1 << m)-1;
+
+	/* the structure comes first, followed by hot work buffers */
+	arena_alloc(arena, sizeof(*bch));
+	bch->ecc_buf   = arena_alloc(arena, words*sizeof(*bch->ecc_buf));
+	bch->ecc_buf2  = arena_alloc(arena, words*sizeof(*bch->ecc_buf2));
+	bch->syn       = arena_alloc(arena, 2*t*sizeof(*bch->syn));
+	bch->cache     = arena_alloc(arena, 2*t*sizeof(*bch->cache));
+	bch->errloc    = arena_alloc(arena, t*sizeof(*bch->errloc));
+	bch->elp       = arena_alloc(arena, (t+1)*sizeof(struct gf_poly_deg1));
+
+	for (i = 0; i < ARRAY_SIZE(bch->poly_2t); i++)
+		bch->poly_2t[i] = arena_alloc(arena, GF_POLY_SZ(2*t));
+
+	/* read-only tables are kept contiguous */
+	if (gf && enc) {
+		gf->a_pow_tab = arena_alloc(arena, (n+1)*sizeof(bch_gf_t));
+		gf->a_log_tab = arena_alloc(arena, (n+1)*sizeof(bch_gf_t));
+		gf->xi_tab    = arena_alloc(arena, m*sizeof(unsigned int));
+		enc->mod8_tab = arena_alloc(arena, words*1024*sizeof(uint32_t));
+	}
+}
+
+/*
+ * allocate a zeroed arena of at least @size bytes, aligned on a cache line
+ */
+static void *alloc_arena(size_t *size, const struct bch_opts *opts,
+			 void **base)
+{
+#if !defined(__KERNEL__)
+	const size_t huge_size = 1ul << 21;
+	int flags = MAP_PRIVATE|MAP_ANONYMOUS;
+	void *ptr;
+
+	if (!opts->alloc &&
+	    (opts->flags & (BCH_OPT_HUGEPAGE|BCH_OPT_POPULATE))) {
+		if (opts->flags & BCH_OPT_POPULATE)
+			flags |= MAP_POPULATE;
+		if (opts->flags & BCH_OPT_HUGEPAGE) {
+			/* try reserved huge pages, then transparent ones */
+			ptr = mmap(NULL, ALIGN(*size, huge_size),
+				   PROT_READ|PROT_WRITE, flags|MAP_HUGETLB,
+				   -1, 0);
+			if (ptr != MAP_FAILED) {
+				*size = ALIGN(*size, huge_size);
+				*base = ptr;
+				return ptr;
+			}
+		}
+		*size = ALIGN(*size, (size_t)sysconf(_SC_PAGESIZE));
+		ptr = mmap(NULL, *size, PROT_READ|PROT_WRITE, flags, -1, 0);
+		if (ptr == MAP_FAILED)
+			return NULL;
+		if (opts->flags & BCH_OPT_HUGEPAGE)
+			madvise(ptr, *size, MADV_HUGEPAGE);
+		*base = ptr;
+		return ptr;
+	}
+#endif
+	*size += L1_CACHE_BYTES-1;
+	if (opts->alloc) {
+		*base = opts->alloc(*size, opts->priv);
+		if (*base)
+			memset(*base, 0, *size);
+	} else {
+		*base = kzalloc(*size, GFP_KERNEL);
+	}
+	return *base ? PTR_ALIGN(*base, L1_CACHE_BYTES) : NULL;
+}
+
+static void free_arena(void *base, size_t size, const struct bch_opts *opts)
+{
+	if (opts->alloc) {
+		opts->free(base, size, opts->priv);
+		return;
+	}
+#if !defined(__KERNEL__)
+	if (opts->flags & (BCH_OPT_HUGEPAGE|BCH_OPT_POPULATE)) {
+		munmap(base, size);
+		return;
+	}
+#endif
+	kfree(base);
+}
+
+/*
+ * allocate a control structure and its work buffers, and optionally the
+ * storage of its private tables, in a single arena
+ */
+static struct bch_control *alloc_bch_control(int m, int t,
+					     const struct bch_opts *opts,
+					     struct bch_gf_tables *gf,
+					     struct bch_enc_tables *enc)
+{
+	static const struct bch_opts default_opts;
+	struct bch_arena arena = {NULL, 0};
+	struct bch_control *bch, scratch;
+	size_t size;
+	void *base;
+
+	if (opts == NULL)
+		opts = &default_opts;
+
+	layout_bch_arena(&arena, &scratch, m, t, gf, enc);
+	size = arena.size;
+	arena.base = alloc_arena(&size, opts, &base);
+	if (arena.base == NULL)
+		return NULL;
+
+	bch = (struct bch_control *)arena.base;
+	arena.size = 0;
+	layout_bch_arena(&arena, bch, m, t, gf, enc);
+	bch->opts = *opts;
+	bch->arena = base;
+	bch->arena_size = size;
+	bch->m = m;
+	bch->t = t;
+	bch->n = (1 << m)-1;
+	bch->ecc_bytes = DIV_ROUND_UP(m*t, 8);
+
+	select_bch_spec(bch);
+	return bch;
+}
+
+/*
+ * build lookup tables into the instance arena, instead of sharing them
+ */
+static int build_private_tables(struct bch_control *bch,
+				struct bch_gf_tables *gf,
+				struct bch_enc_tables *enc)
+{
+	uint32_t *genpoly;
+
+	if (build_gf_tables(bch, gf))
+		return -EINVAL;
+
+	/* field operations are needed for building the degree 2 base */
+	bch->a_pow_tab = gf->a_pow_tab;
+	bch->a_log_tab = gf->a_log_tab;
+
+	if (build_deg2_base(bch, gf))
+		return -EINVAL;
+
+	bch->xi_tab = gf->xi_tab;
+
+	genpoly = compute_generator_polynomial(bch);
+	if (genpoly == NULL)
+		return -ENOMEM;
+
+	build_mod8_tables(bch, enc, genpoly);
+	kfree(genpoly);
+	bch->mod8_tab = enc->mod8_tab;
+	return 0;
+}
+
 /**
  * init_bch - initialize a BCH encoder/decoder
- * @m:          Galois field order, should be in the range 5-15
+ * @m:          Galois field order, should be in the range 5-BCH_MAX_M (16,
+ *              or up to 20 with CONFIG_BCH_MAX_M)
  * @t:          maximum error correction capability, in bits
  * @prim_poly:  user-provided primitive polynomial (or 0 to use default)
  *
@@ -1240,6 +2660,11 @@ finish:
  * path. Usually, init_bch() should be called on module/driver init and
  * free_bch() should be called to release memory on exit.
  *
+ * Lookup tables are read-only once built, and are shared between all
+ * instances using the same parameters: Galois field tables for a given
+ * (@m,@prim_poly) pair, and encoding tables for a given (@m,@t,@prim_poly)
+ * triplet. Tables are released when the last instance using them is freed.
+ *
  * You may provide your own primitive polynomial of degree @m in argument
  * @prim_poly, or let init_bch() use its default polynomial.
  *
@@ -1249,18 +2674,57 @@ finish:
  */
 struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 {
-	int err = 0;
-	unsigned int i, words;
-	uint32_t *genpoly;
+	return init_bch_opts(m, t, prim_poly, NULL);
+}
+EXPORT_SYMBOL_GPL(init_bch);
+
+/**
+ * init_bch_opts - initialize a BCH encoder/decoder with options
+ * @m:          Galois field order, should be in the range 5-BCH_MAX_M
+ * @t:          maximum error correction capability, in bits
+ * @prim_poly:  user-provided primitive polynomial (or 0 to use default)
+ * @opts:       allocation and bit order options, or NULL for defaults
+ *
+ * Returns:
+ *  a newly allocated BCH control structure if successful, NULL otherwise
+ *
+ * Same as init_bch(), with control over instance memory and bit order. The
+ * control structure and all its work buffers are laid out in a single arena,
+ * each buffer starting on a cache line boundary.
+ *
+ * If @opts->alloc is provided, the arena is obtained from it, e.g. from memory
+ * preallocated by a real-time thread, and released with @opts->free. Flag
+ * BCH_OPT_PRIVATE_TABLES places the lookup tables in the arena, contiguous
+ * and right after the work buffers, instead of sharing them with other
+ * instances; no other memory is then held by the instance. In userspace,
+ * flags BCH_OPT_HUGEPAGE and BCH_OPT_POPULATE map the arena with huge pages
+ * (reserved ones if available, transparent ones otherwise) and prefault it;
+ * they are ignored if @opts->alloc is provided.
+ *
+ * Flag BCH_OPT_LSB_FIRST selects LSB-first bit order for data and ecc: the
+ * first codeword bit is bit 0 of the first data byte, instead of bit 7. Ecc
+ * bytes are stored in the same order, unused bits of the last ecc byte being
+ * the most significant ones. Error locations keep the decode_bch() meaning,
+ * i.e. bit (l % 8) of byte (l / 8), so that correction code does not depend
+ * on bit order. Encoding and decoding run at the same speed in both orders.
+ */
+struct bch_control *init_bch_opts(int m, int t, unsigned int prim_poly,
+				  const struct bch_opts *opts)
+{
 	struct bch_control *bch = NULL;
+	struct bch_gf_tables gf, *priv_gf = NULL;
+	struct bch_enc_tables enc, *priv_enc = NULL;
+#if defined(CONFIG_BCH_CONST_TABLES)
+	int const_tables;
+#endif
 
 	const int min_m = 5;
-	const int max_m = 15;
+	const int max_m = BCH_MAX_M;
 
 	/* default primitive polynomials */
 	static const unsigned int prim_poly_tab[] = {
 		0x25, 0x43, 0x83, 0x11d, 0x211, 0x409, 0x805, 0x1053, 0x201b,
-		0x402b, 0x8003,
+		0x402b, 0x8003, 0x1002d, 0x20009, 0x40081, 0x80027, 0x100009,
 	};
 
 #if defined(CONFIG_BCH_CONST_PARAMS)
@@ -1273,9 +2737,9 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 #endif
 	if ((m < min_m) || (m > max_m))
 		/*
-		 * values of m greater than 15 are not currently supported;
-		 * supporting m > 15 would require changing table base type
-		 * (uint16_t) and a small patch in matrix transposition
+		 * values of m greater than BCH_MAX_M (at most 20) are not
+		 * supported; supporting larger values would require impractically large
+		 * 2^m-entry lookup tables (a_pow_tab, a_log_tab)
 		 */
 		goto fail;
 
@@ -1284,49 +2748,57 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 		/* invalid t value */
 		goto fail;
 
+	if (opts && opts->alloc && !opts->free)
+		/* custom allocator without release function */
+		goto fail;
+
 	/* select a primitive polynomial for generating GF(2^m) */
 	if (prim_poly == 0)
 		prim_poly = prim_poly_tab[m-min_m];
 
-	bch = kzalloc(sizeof(*bch), GFP_KERNEL);
+	if (opts && (opts->flags & BCH_OPT_PRIVATE_TABLES)) {
+		memset(&gf, 0, sizeof(gf));
+		memset(&enc, 0, sizeof(enc));
+		gf.m = m;
+		gf.prim_poly = prim_poly;
+		priv_gf = &gf;
+		priv_enc = &enc;
+	}
+#if defined(CONFIG_BCH_CONST_TABLES)
+	/* precomputed tables need no storage, they are MSB-first */
+	const_tables = (prim_poly == BCH_CONST_TABLES_PRIM_POLY) &&
+		!(opts && (opts->flags & BCH_OPT_LSB_FIRST));
+	if (const_tables) {
+		priv_gf = NULL;
+		priv_enc = NULL;
+	}
+#endif
+	bch = alloc_bch_control(m, t, opts, priv_gf, priv_enc);
 	if (bch == NULL)
 		goto fail;
 
-	bch->m = m;
-	bch->t = t;
-	bch->n = (1 << m)-1;
-	words  = DIV_ROUND_UP(m*t, 32);
-	bch->ecc_bytes = DIV_ROUND_UP(m*t, 8);
-	bch->a_pow_tab = bch_alloc((1+bch->n)*sizeof(*bch->a_pow_tab), &err);
-	bch->a_log_tab = bch_alloc((1+bch->n)*sizeof(*bch->a_log_tab), &err);
-	bch->mod8_tab  = bch_alloc(words*1024*sizeof(*bch->mod8_tab), &err);
-	bch->ecc_buf   = bch_alloc(words*sizeof(*bch->ecc_buf), &err);
-	bch->ecc_buf2  = bch_alloc(words*sizeof(*bch->ecc_buf2), &err);
-	bch->xi_tab    = bch_alloc(m*sizeof(*bch->xi_tab), &err);
-	bch->syn       = bch_alloc(2*t*sizeof(*bch->syn), &err);
-	bch->cache     = bch_alloc(2*t*sizeof(*bch->cache), &err);
-	bch->elp       = bch_alloc((t+1)*sizeof(struct gf_poly_deg1), &err);
-
-	for (i = 0; i < ARRAY_SIZE(bch->poly_2t); i++)
-		bch->poly_2t[i] = bch_alloc(GF_POLY_SZ(2*t), &err);
-
-	if (err)
-		goto fail;
-
-	err = build_gf_tables(bch, prim_poly);
-	if (err)
-		goto fail;
-
-	/* use generator polynomial for computing encoding tables */
-	genpoly = compute_generator_polynomial(bch);
-	if (genpoly == NULL)
+#if defined(CONFIG_BCH_CONST_TABLES)
+	if (const_tables) {
+		/* use precomputed tables, no need to reference shared ones */
+		bch->a_pow_tab = bch_const_a_pow_tab;
+		bch->a_log_tab = bch_const_a_log_tab;
+		bch->mod8_tab  = bch_const_mod8_tab;
+		bch->xi_tab    = bch_const_xi_tab;
+		bch->ecc_bits  = BCH_CONST_TABLES_ECC_BITS;
+		return bch;
+	}
+#endif
+	if (priv_gf) {
+		if (build_private_tables(bch, priv_gf, priv_enc))
+			goto fail;
+		return bch;
+	}
+	bch->gf = get_gf_tables(bch, prim_poly);
+	if (bch->gf == NULL)
 		goto fail;
 
-	build_mod8_tables(bch, genpoly);
-	kfree(genpoly);
-
-	err = build_deg2_base(bch);
-	if (err)
+	bch->enc = get_enc_tables(bch, prim_poly);
+	if (bch->enc == NULL)
 		goto fail;
 
 	return bch;
@@ -1335,7 +2807,7 @@ fail:
 	free_bch(bch);
 	return NULL;
 }
-EXPORT_SYMBOL_GPL(init_bch);
+EXPORT_SYMBOL_GPL(init_bch_opts);
 
 /**
  *  free_bch - free the BCH control structure
@@ -1343,27 +2815,360 @@ EXPORT_SYMBOL_GPL(init_bch);
  */
 void free_bch(struct bch_control *bch)
 {
-	unsigned int i;
+	struct bch_opts opts;
 
 	if (bch) {
-		kfree(bch->a_pow_tab);
-		kfree(bch->a_log_tab);
-		kfree(bch->mod8_tab);
-		kfree(bch->ecc_buf);
-		kfree(bch->ecc_buf2);
-		kfree(bch->xi_tab);
-		kfree(bch->syn);
-		kfree(bch->cache);
-		kfree(bch->elp);
+		put_enc_tables(bch->enc);
+		put_gf_tables(bch->gf);
 
-		for (i = 0; i < ARRAY_SIZE(bch->poly_2t); i++)
-			kfree(bch->poly_2t[i]);
-
-		kfree(bch);
+#if !defined(__KERNEL__)
+		if (bch->snapshot)
+			munmap(bch->snapshot, bch->snapshot_size);
+#endif
+		/* the structure lives in the arena */
+		opts = bch->opts;
+		free_arena(bch->arena, bch->arena_size, &opts);
 	}
 }
 EXPORT_SYMBOL_GPL(free_bch);
 
+/**
+ * bch_get_kernel - get the name of the encoder/decoder used by an instance
+ * @bch:    BCH control structure
+ *
+ * Returns:
+ *  the name of the variant bound to @bch by init_bch() or bch_set_kernel(),
+ *  such as "m13t4" or "x86_64_v3", or "generic"
+ */
+const char *bch_get_kernel(struct bch_control *bch)
+{
+	return bch->spec ? bch->spec->name : "generic";
+}
+EXPORT_SYMBOL_GPL(bch_get_kernel);
+
+/**
+ * bch_set_kernel - force the encoder/decoder used by an instance
+ * @bch:    BCH control structure
+ * @name:   variant name, as returned by bch_get_kernel()
+ *
+ * Returns:
+ *  0 if successful, -ENOENT if no such variant was built, -EINVAL if the
+ *  variant was built for different (m,t) parameters, or -ENODEV if the
+ *  variant requires instructions not supported by the cpu
+ *
+ * This function is mostly useful to compare variants; it must not be called
+ * while another thread is using @bch.
+ */
+int bch_set_kernel(struct bch_control *bch, const char *name)
+{
+	const struct bch_spec *const *spec;
+	int err;
+
+	if (!strcmp(name, "generic")) {
+		bch->spec = NULL;
+		return 0;
+	}
+	for (spec = bch_spec_list; *spec; spec++) {
+		if (strcmp((*spec)->name, name))
+			continue;
+		err = check_bch_spec(bch, *spec);
+		if (!err)
+			bch->spec = *spec;
+		return err;
+	}
+	return -ENOENT;
+}
+EXPORT_SYMBOL_GPL(bch_set_kernel);
+
+/**
+ * bch_get_stats - read decoding statistics of an instance
+ * @bch:    BCH control structure
+ * @stats:  output statistics
+ *
+ * Returns:
+ *  0 if successful, or -EOPNOTSUPP if the library was built without
+ *  CONFIG_BCH_STATS
+ *
+ * Statistics are accumulated by decode_bch(), decode_bch_batch(),
+ * decode_bch_soft() and all decoding functions built on them, since init_bch()
+ * or the last call to bch_reset_stats(). Cycle counts are read with
+ * get_cycles(). Statistics are not synchronized: read them from the thread
+ * using @bch.
+ */
+int bch_get_stats(struct bch_control *bch, struct bch_stats *stats)
+{
+#if defined(CONFIG_BCH_STATS)
+	*stats = bch->stats;
+	return 0;
+#else
+	memset(stats, 0, sizeof(*stats));
+	return -EOPNOTSUPP;
+#endif
+}
+EXPORT_SYMBOL_GPL(bch_get_stats);
+
+/**
+ * bch_reset_stats - clear decoding statistics of an instance
+ * @bch:    BCH control structure
+ */
+void bch_reset_stats(struct bch_control *bch)
+{
+#if defined(CONFIG_BCH_STATS)
+	memset(&bch->stats, 0, sizeof(bch->stats));
+#endif
+}
+EXPORT_SYMBOL_GPL(bch_reset_stats);
+
+/*
+ * Snapshot format: a header followed by lookup tables, all fields are 32-bit
+ * words in native byte order. Tables start on 64-byte boundaries, so that a
+ * snapshot mapped in memory can be used in place without any copy.
+ */
+#define BCH_SNAPSHOT_MAGIC     0x53484342  /* "BCHS" on little-endian cpus */
+#define BCH_SNAPSHOT_VERSION   1
+#define BCH_SNAPSHOT_ALIGN(_x) (((_x)+63) & ~63u)
+
+#define BCH_SNAPSHOT_LSB_FIRST 0x1         /* tables of an LSB-first instance */
+#define BCH_SNAPSHOT_GF16      0x2         /* 16-bit Galois field tables */
+
+struct bch_snapshot_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;        /* total snapshot size in bytes */
+	uint32_t m;
+	uint32_t t;
+	uint32_t prim_poly;
+	uint32_t ecc_bits;
+	uint32_t flags;       /* BCH_SNAPSHOT_* flags */
+	uint32_t a_pow_off;   /* table offsets in bytes from snapshot start */
+	uint32_t a_log_off;
+	uint32_t mod8_off;
+	uint32_t xi_off;
+};
+
+/*
+ * compute snapshot table offsets and total size for given (m,t) parameters
+ */
+static uint32_t snapshot_layout(unsigned int m, unsigned int t,
+				struct bch_snapshot_header *hdr)
+{
+	const unsigned int n = (1 << m)-1;
+
+	hdr->a_pow_off = BCH_SNAPSHOT_ALIGN(sizeof(*hdr));
+	hdr->a_log_off = BCH_SNAPSHOT_ALIGN(hdr->a_pow_off+
+					    (n+1)*sizeof(bch_gf_t));
+	hdr->mod8_off  = BCH_SNAPSHOT_ALIGN(hdr->a_log_off+
+					    (n+1)*sizeof(bch_gf_t));
+	hdr->xi_off    = BCH_SNAPSHOT_ALIGN(hdr->mod8_off+
+					    DIV_ROUND_UP(m*t, 32)*1024*4);
+	hdr->size      = hdr->xi_off+m*4;
+
+	return hdr->size;
+}
+
+/**
+ * save_bch_snapshot - serialize BCH lookup tables and parameters
+ * @bch:   BCH control structure
+ * @buf:   output buffer, or NULL to query the snapshot size
+ * @size:  output buffer size in bytes
+ *
+ * Returns:
+ *  the snapshot size in bytes, or -ENOSPC if @buf is too small
+ *
+ * The snapshot contains all lookup tables of @bch, and can be loaded with
+ * init_bch_snapshot() to get an equivalent control structure without any
+ * table computation. Snapshots use native byte order and table entry size,
+ * and are not portable across architectures of different endianness, or
+ * across builds with and without 16-bit Galois field tables (BCH_MAX_M).
+ */
+int save_bch_snapshot(struct bch_control *bch, void *buf, size_t size)
+{
+	struct bch_snapshot_header hdr;
+	uint8_t *p = buf;
+
+	memset(&hdr, 0, sizeof(hdr));
+	snapshot_layout(GF_M(bch), GF_T(bch), &hdr);
+
+	if (buf == NULL)
+		return hdr.size;
+	if (size < hdr.size)
+		return -ENOSPC;
+
+	hdr.magic     = BCH_SNAPSHOT_MAGIC;
+	hdr.version   = BCH_SNAPSHOT_VERSION;
+	hdr.m         = GF_M(bch);
+	hdr.t         = GF_T(bch);
+	/* a^m = prim_poly(a)-a^m */
+	hdr.prim_poly = bch->a_pow_tab[GF_M(bch)] | (1u << GF_M(bch));
+	hdr.ecc_bits  = bch->ecc_bits;
+	hdr.flags     = lsb_first(bch) ? BCH_SNAPSHOT_LSB_FIRST : 0;
+	if (sizeof(bch_gf_t) == 2)
+		hdr.flags |= BCH_SNAPSHOT_GF16;
+
+	memset(p, 0, hdr.size);
+	memcpy(p, &hdr, sizeof(hdr));
+	memcpy(p+hdr.a_pow_off, bch->a_pow_tab, (GF_N(bch)+1)*sizeof(bch_gf_t));
+	memcpy(p+hdr.a_log_off, bch->a_log_tab, (GF_N(bch)+1)*sizeof(bch_gf_t));
+	memcpy(p+hdr.mod8_off, bch->mod8_tab, BCH_ECC_WORDS(bch)*1024*4);
+	memcpy(p+hdr.xi_off, bch->xi_tab, GF_M(bch)*4);
+
+	return hdr.size;
+}
+EXPORT_SYMBOL_GPL(save_bch_snapshot);
+
+/**
+ * init_bch_snapshot - initialize a BCH encoder/decoder from a snapshot
+ * @buf:   snapshot data, as produced by save_bch_snapshot()
+ * @size:  snapshot size in bytes
+ *
+ * Returns:
+ *  a newly allocated BCH control structure if successful, NULL otherwise
+ *
+ * Lookup tables are used in place: @buf must be 32-bit aligned, and must
+ * remain valid and unmodified until free_bch() is called on the returned
+ * structure. Only the snapshot header is validated, table contents are
+ * trusted.
+ */
+struct bch_control *init_bch_snapshot(const void *buf, size_t size)
+{
+	struct bch_snapshot_header layout;
+	const struct bch_snapshot_header *hdr = buf;
+	const uint8_t *p = buf;
+	struct bch_control *bch;
+	struct bch_opts opts;
+
+	if ((buf == NULL) || (size < sizeof(*hdr)) ||
+	    (((unsigned long)buf) & 3))
+		return NULL;
+
+	if ((hdr->magic != BCH_SNAPSHOT_MAGIC) ||
+	    (hdr->version != BCH_SNAPSHOT_VERSION) ||
+	    (hdr->flags & ~(BCH_SNAPSHOT_LSB_FIRST|BCH_SNAPSHOT_GF16)))
+		return NULL;
+
+	/* table entry size must match this build */
+	if (!!(hdr->flags & BCH_SNAPSHOT_GF16) != (sizeof(bch_gf_t) == 2))
+		return NULL;
+
+	if ((hdr->m < 5) || (hdr->m > BCH_MAX_M) || (hdr->t < 1) ||
+	    (hdr->m*hdr->t >= ((1u << hdr->m)-1)) ||
+	    (hdr->ecc_bits > hdr->m*hdr->t))
+		return NULL;
+
+#if defined(CONFIG_BCH_CONST_PARAMS)
+	if ((hdr->m != (CONFIG_BCH_CONST_M)) ||
+	    (hdr->t != (CONFIG_BCH_CONST_T)))
+		return NULL;
+#endif
+	/* table layout is fully determined by (m,t) */
+	memset(&layout, 0, sizeof(layout));
+	snapshot_layout(hdr->m, hdr->t, &layout);
+
+	if ((hdr->size != layout.size) || (size < layout.size) ||
+	    (hdr->a_pow_off != layout.a_pow_off) ||
+	    (hdr->a_log_off != layout.a_log_off) ||
+	    (hdr->mod8_off != layout.mod8_off) ||
+	    (hdr->xi_off != layout.xi_off))
+		return NULL;
+
+	memset(&opts, 0, sizeof(opts));
+	if (hdr->flags & BCH_SNAPSHOT_LSB_FIRST)
+		opts.flags = BCH_OPT_LSB_FIRST;
+
+	bch = alloc_bch_control(hdr->m, hdr->t, &opts, NULL, NULL);
+	if (bch == NULL)
+		return NULL;
+
+	bch->ecc_bits  = hdr->ecc_bits;
+	bch->a_pow_tab = (const bch_gf_t *)(p+hdr->a_pow_off);
+	bch->a_log_tab = (const bch_gf_t *)(p+hdr->a_log_off);
+	bch->mod8_tab  = (const uint32_t *)(p+hdr->mod8_off);
+	bch->xi_tab    = (const unsigned int *)(p+hdr->xi_off);
+
+	return bch;
+}
+EXPORT_SYMBOL_GPL(init_bch_snapshot);
+
+#if !defined(__KERNEL__)
+/**
+ * save_bch_file - write a BCH snapshot to a file
+ * @bch:   BCH control structure
+ * @path:  output file path
+ *
+ * Returns:
+ *  0 if successful, a negative error code otherwise
+ */
+int save_bch_file(struct bch_control *bch, const char *path)
+{
+	int size, ret = 0;
+	void *buf;
+	FILE *fp;
+
+	size = save_bch_snapshot(bch, NULL, 0);
+	buf = kmalloc(size, GFP_KERNEL);
+	if (buf == NULL)
+		return -ENOMEM;
+
+	save_bch_snapshot(bch, buf, size);
+
+	fp = fopen(path, "wb");
+	if (fp == NULL) {
+		ret = -errno;
+	} else {
+		if (fwrite(buf, size, 1, fp) != 1)
+			ret = -EIO;
+		if (fclose(fp) && !ret)
+			ret = -EIO;
+	}
+	kfree(buf);
+	return ret;
+}
+
+/**
+ * init_bch_from_file - initialize a BCH encoder/decoder from a snapshot file
+ * @path:  snapshot file path, as written by save_bch_file()
+ *
+ * Returns:
+ *  a newly allocated BCH control structure if successful, NULL otherwise
+ *
+ * The snapshot file is mapped read-only and its tables are used in place, so
+ * that processes loading the same file share a single page cache copy. The
+ * mapping is released by free_bch().
+ */
+struct bch_control *init_bch_from_file(const char *path)
+{
+	int fd;
+	void *map;
+	off_t size;
+	struct bch_control *bch = NULL;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	size = lseek(fd, 0, SEEK_END);
+	if (size <= 0) {
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	bch = init_bch_snapshot(map, size);
+	if (bch == NULL) {
+		munmap(map, size);
+		return NULL;
+	}
+	bch->snapshot = map;
+	bch->snapshot_size = size;
+
+	return bch;
+}
+#endif /* !__KERNEL__ */
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Ivan Djelic <ivan.djelic@parrot.com>");
 MODULE_DESCRIPTION("Binary BCH encoder/decoder");
+#endif /* !BCH_SPEC_VARIANT */
@@ -0,0 +1,418 @@
+/*
+ * Multi-threaded BCH decoding engine (userspace only)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Description:
+ *
+ * This engine spreads decode_bch() calls of one or several I/O threads over a
+ * pool of worker threads.
+ *
+ * Callers push jobs into a submission ring with bch_engine_submit(), and
+ * retrieve completed jobs from a completion ring with bch_engine_reap(). Both
+ * rings are bounded lock-free multi-producer multi-consumer queues (Dmitry
+ * Vyukov's design): each cell carries a sequence number telling producers and
+ * consumers whether it is free or holds a published entry, so that enqueueing
+ * or dequeueing an entry only costs a compare-and-swap on the ring position.
+ *
+ * Each worker owns a bch_control instance (lookup tables are shared between
+ * instances, see init_bch()), hence its own decoding workspace. Idle workers
+ * sleep on a semaphore, posted once per submitted job; a woken up worker grabs
+ * up to @batch pending jobs at once. The number of jobs in flight is bounded
+ * by the ring size, so that the completion ring can never overflow.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <linux/kernel.h>
+#include <linux/bch.h>
+#include <linux/bch_engine.h>
+
+#define BCH_ENGINE_CACHELINE	64
+#define BCH_ENGINE_BATCH	8
+
+/* keep ring positions and counters on separate cache lines */
+#define __engine_aligned __attribute__((aligned(BCH_ENGINE_CACHELINE)))
+
+struct bch_ring_cell {
+	unsigned long           seq;
+	struct bch_engine_job  *job;
+};
+
+struct bch_ring {
+	unsigned long           head __engine_aligned;
+	unsigned long           tail __engine_aligned;
+	unsigned long           mask __engine_aligned;
+	struct bch_ring_cell   *cells;
+};
+
+struct bch_worker {
+	struct bch_engine      *engine;
+	struct bch_control     *bch;
+	pthread_t               thread;
+	int                     started;
+};
+
+struct bch_engine {
+	struct bch_ring         sq;
+	struct bch_ring         cq;
+	sem_t                   sq_sem;
+	sem_t                   cq_sem;
+	unsigned long           inflight __engine_aligned;
+	int                     stop;
+	unsigned int            batch;
+	unsigned int            nworkers;
+	struct bch_worker      *workers;
+};
+
+static int ring_init(struct bch_ring *ring, unsigned int size)
+{
+	unsigned long i;
+
+	ring->cells = calloc(size, sizeof(*ring->cells));
+	if (!ring->cells)
+		return -ENOMEM;
+
+	for (i = 0; i < size; i++)
+		ring->cells[i].seq = i;
+
+	ring->mask = size-1;
+	ring->head = 0;
+	ring->tail = 0;
+	return 0;
+}
+
+/*
+ * enqueue an entry, return 0 if the ring is full
+ */
+static int ring_push(struct bch_ring *ring, struct bch_engine_job *job)
+{
+	struct bch_ring_cell *cell;
+	unsigned long pos, seq;
+	long dif;
+
+	pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+	for (;;) {
+		cell = &ring->cells[pos & ring->mask];
+		seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+		dif = (long)seq-(long)pos;
+		if (dif == 0) {
+			/* cell is free, try to reserve it */
+			if (__atomic_compare_exchange_n(&ring->tail, &pos,
+							pos+1, 1,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if (dif < 0) {
+			return 0;
+		} else {
+			pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+		}
+	}
+	cell->job = job;
+	/* publish entry */
+	__atomic_store_n(&cell->seq, pos+1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+/*
+ * dequeue an entry, return NULL if the ring is empty
+ */
+static struct bch_engine_job *ring_pop(struct bch_ring *ring)
+{
+	struct bch_ring_cell *cell;
+	struct bch_engine_job *job;
+	unsigned long pos, seq;
+	long dif;
+
+	pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	for (;;) {
+		cell = &ring->cells[pos & ring->mask];
+		seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+		dif = (long)seq-(long)(pos+1);
+		if (dif == 0) {
+			/* cell holds an entry, try to claim it */
+			if (__atomic_compare_exchange_n(&ring->head, &pos,
+							pos+1, 1,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if (dif < 0) {
+			return NULL;
+		} else {
+			pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+		}
+	}
+	job = cell->job;
+	/* release cell for the next round of producers */
+	__atomic_store_n(&cell->seq, pos+ring->mask+1, __ATOMIC_RELEASE);
+	return job;
+}
+
+/*
+ * dequeue an entry known to be published or about to be published: a
+ * semaphore token is only posted after its entry has been enqueued, but a
+ * concurrent consumer may have taken that entry while another producer has
+ * not finished publishing the next one
+ */
+static struct bch_engine_job *ring_pop_wait(struct bch_ring *ring)
+{
+	struct bch_engine_job *job;
+
+	while ((job = ring_pop(ring)) == NULL)
+		sched_yield();
+
+	return job;
+}
+
+static void *bch_worker_run(void *arg)
+{
+	struct bch_worker *worker = arg;
+	struct bch_engine *engine = worker->engine;
+	struct bch_engine_job *jobs[BCH_ENGINE_BATCH], *job;
+	unsigned int i, n;
+
+	for (;;) {
+		while (sem_wait(&engine->sq_sem) && (errno == EINTR))
+			;
+		/* the stop token is only posted once all jobs are completed */
+		if (__atomic_load_n(&engine->stop, __ATOMIC_ACQUIRE) &&
+		    !__atomic_load_n(&engine->inflight, __ATOMIC_ACQUIRE))
+			break;
+
+		/* grab extra pending jobs without sleeping */
+		n = 1;
+		while ((n < engine->batch) && !sem_trywait(&engine->sq_sem))
+			n++;
+
+		for (i = 0; i < n; i++)
+			jobs[i] = ring_pop_wait(&engine->sq);
+
+		for (i = 0; i < n; i++) {
+			job = jobs[i];
+			job->nerr = decode_bch(worker->bch, job->data, job->len,
+					       job->ecc, NULL, NULL,
+					       job->errloc);
+		}
+		for (i = 0; i < n; i++) {
+			/*
+			 * in-flight jobs never exceed ring size, at worst a
+			 * consumer has not yet released its cell
+			 */
+			while (!ring_push(&engine->cq, jobs[i]))
+				sched_yield();
+			sem_post(&engine->cq_sem);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * bch_engine_create - create a decoding engine
+ * @m:          Galois field order, should be in the range 5-20
+ * @t:          maximum error correction capability, in bits
+ * @prim_poly:  user-provided primitive polynomial (or 0 to use default)
+ * @opts:       engine options
+ *
+ * Returns:
+ *  a newly allocated engine, or NULL in case of error
+ *
+ * Parameters @m, @t and @prim_poly are passed to init_bch() in order to
+ * create one BCH control structure per worker thread.
+ */
+struct bch_engine *bch_engine_create(int m, int t, unsigned int prim_poly,
+				     const struct bch_engine_opts *opts)
+{
+	struct bch_engine *engine;
+	struct bch_worker *worker;
+	unsigned int i, size;
+	cpu_set_t cpuset;
+	void *ptr;
+
+	if (!opts->nworkers)
+		return NULL;
+
+	for (size = 2; size < opts->ring_size; size <<= 1)
+		;
+
+	if (posix_memalign(&ptr, BCH_ENGINE_CACHELINE, sizeof(*engine)))
+		return NULL;
+
+	engine = ptr;
+	memset(engine, 0, sizeof(*engine));
+	engine->batch = opts->batch ? opts->batch : 1;
+	if (engine->batch > BCH_ENGINE_BATCH)
+		engine->batch = BCH_ENGINE_BATCH;
+
+	if (ring_init(&engine->sq, size) || ring_init(&engine->cq, size))
+		goto fail;
+
+	sem_init(&engine->sq_sem, 0, 0);
+	sem_init(&engine->cq_sem, 0, 0);
+
+	engine->workers = calloc(opts->nworkers, sizeof(*engine->workers));
+	if (!engine->workers)
+		goto fail;
+
+	engine->nworkers = opts->nworkers;
+	for (i = 0; i < engine->nworkers; i++) {
+		worker = &engine->workers[i];
+		worker->engine = engine;
+		worker->bch = init_bch(m, t, prim_poly);
+		if (!worker->bch)
+			goto fail;
+	}
+
+	for (i = 0; i < engine->nworkers; i++) {
+		worker = &engine->workers[i];
+		if (pthread_create(&worker->thread, NULL, bch_worker_run,
+				   worker))
+			goto fail;
+
+		worker->started = 1;
+		if (opts->cpus) {
+			CPU_ZERO(&cpuset);
+			CPU_SET(opts->cpus[i], &cpuset);
+			pthread_setaffinity_np(worker->thread, sizeof(cpuset),
+					       &cpuset);
+		}
+	}
+	return engine;
+fail:
+	bch_engine_destroy(engine);
+	return NULL;
+}
+
+/**
+ * bch_engine_destroy - stop worker threads and free engine resources
+ * @engine:     engine returned by bch_engine_create()
+ *
+ * This function waits for all submitted jobs to complete; completed jobs
+ * which have not been reaped are discarded.
+ */
+void bch_engine_destroy(struct bch_engine *engine)
+{
+	struct bch_engine_job *job;
+	unsigned int i;
+
+	if (!engine)
+		return;
+
+	/* drain completion ring until in-flight jobs are all done */
+	while (__atomic_load_n(&engine->inflight, __ATOMIC_ACQUIRE)) {
+		job = ring_pop(&engine->cq);
+		if (job)
+			__atomic_sub_fetch(&engine->inflight, 1,
+					   __ATOMIC_RELEASE);
+		else
+			sched_yield();
+	}
+
+	__atomic_store_n(&engine->stop, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < engine->nworkers; i++)
+		sem_post(&engine->sq_sem);
+
+	for (i = 0; i < engine->nworkers; i++) {
+		if (engine->workers[i].started)
+			pthread_join(engine->workers[i].thread, NULL);
+		free_bch(engine->workers[i].bch);
+	}
+	if (engine->workers) {
+		sem_destroy(&engine->sq_sem);
+		sem_destroy(&engine->cq_sem);
+	}
+	free(engine->workers);
+	free(engine->sq.cells);
+	free(engine->cq.cells);
+	free(engine);
+}
+
+/**
+ * bch_engine_submit - submit decoding jobs
+ * @engine:     engine returned by bch_engine_create()
+ * @jobs:       array of jobs to submit
+ * @njobs:      number of jobs in @jobs
+ *
+ * Returns:
+ *  the number of submitted jobs, or -EAGAIN if the maximum number of jobs in
+ *  flight was reached before submitting any job
+ *
+ * This function never blocks; jobs are submitted in order, and submission
+ * stops when the engine is full. Once decoded, the result of decode_bch(bch,
+ * @data, @len, @ecc, NULL, NULL, @errloc) is stored in member @nerr of each
+ * job.
+ */
+int bch_engine_submit(struct bch_engine *engine, struct bch_engine_job **jobs,
+		      unsigned int njobs)
+{
+	const unsigned long size = engine->sq.mask+1;
+	unsigned long inflight;
+	unsigned int i;
+
+	/* reserve room for jobs in both rings */
+	inflight = __atomic_load_n(&engine->inflight, __ATOMIC_RELAXED);
+	do {
+		if (inflight >= size)
+			return -EAGAIN;
+		if (njobs > size-inflight)
+			njobs = size-inflight;
+	} while (!__atomic_compare_exchange_n(&engine->inflight, &inflight,
+					      inflight+njobs, 1,
+					      __ATOMIC_ACQUIRE,
+					      __ATOMIC_RELAXED));
+
+	for (i = 0; i < njobs; i++) {
+		while (!ring_push(&engine->sq, jobs[i]))
+			/* a consumer has not yet released its cell */
+			sched_yield();
+		sem_post(&engine->sq_sem);
+	}
+	return njobs;
+}
+
+/**
+ * bch_engine_reap - retrieve completed jobs
+ * @engine:     engine returned by bch_engine_create()
+ * @jobs:       output array of completed jobs
+ * @njobs:      maximum number of jobs to retrieve
+ * @wait:       if non-zero, wait until at least one job is completed
+ *
+ * Returns:
+ *  the number of completed jobs stored into @jobs, in completion order
+ */
+int bch_engine_reap(struct bch_engine *engine, struct bch_engine_job **jobs,
+		    unsigned int njobs, int wait)
+{
+	unsigned int n = 0;
+
+	if (!njobs)
+		return 0;
+
+	if (wait) {
+		while (sem_wait(&engine->cq_sem) && (errno == EINTR))
+			;
+		jobs[n++] = ring_pop_wait(&engine->cq);
+	}
+	while ((n < njobs) && !sem_trywait(&engine->cq_sem))
+		jobs[n++] = ring_pop_wait(&engine->cq);
+
+	__atomic_sub_fetch(&engine->inflight, n, __ATOMIC_RELEASE);
+	return n;
+}
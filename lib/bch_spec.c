@@ -0,0 +1,106 @@
+/*
+ * Specialised BCH encoder/decoder variant for a fixed (m,t) pair
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Description:
+ *
+ * This file is compiled once for each BCH_SPEC(m,t) entry of option
+ * CONFIG_BCH_SPEC_LIST, with -DBCH_SPEC_M=m -DBCH_SPEC_T=t. It builds the
+ * encoding and decoding paths of lib/bch.c with constant parameters, exactly
+ * as CONFIG_BCH_CONST_PARAMS would, under private names (e.g. encode_bch_m13t4
+ * for m=13, t=4), and exports them in a struct bch_spec named after the pair
+ * (e.g. bch_spec_m13t4).
+ *
+ * It is also compiled once for each BCH_ISA(isa) entry of option
+ * CONFIG_BCH_ISA_LIST, with -DBCH_SPEC_ISA=isa and compiler flags targeting
+ * that instruction set (e.g. -march=x86-64-v3 for x86_64_v3). The resulting
+ * variant handles any (m,t) pair, and is only selected if the cpu supports
+ * the instruction set.
+ *
+ * Initialization and table management only exist in the generic build of
+ * lib/bch.c, which binds instances to variants.
+ */
+
+#if defined(BCH_SPEC_ISA)
+#if defined(BCH_SPEC_M) || defined(BCH_SPEC_T) || defined(__KERNEL__)
+#error "BCH_SPEC_ISA is exclusive with BCH_SPEC_M, BCH_SPEC_T and __KERNEL__"
+#endif
+#elif !defined(BCH_SPEC_M) || !defined(BCH_SPEC_T)
+#error "BCH_SPEC_M and BCH_SPEC_T must be defined"
+#endif
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#define __BCH_STR(_s)               #_s
+#define BCH_STR(_s)                 __BCH_STR(_s)
+#define __BCH_SPEC_SYM(_s, _m, _t)  _s##_m##t##_t
+#define BCH_SPEC_SYM(_s, _m, _t)    __BCH_SPEC_SYM(_s, _m, _t)
+#define __BCH_ISA_SYM(_s, _isa)     _s##_##_isa
+#define BCH_ISA_SYM(_s, _isa)       __BCH_ISA_SYM(_s, _isa)
+
+#if defined(BCH_SPEC_ISA)
+#define BCH_SPEC_NAME(_s)           BCH_ISA_SYM(_s, BCH_SPEC_ISA)
+#else
+#define BCH_SPEC_NAME(_s)           BCH_SPEC_SYM(_s##_m, BCH_SPEC_M, BCH_SPEC_T)
+#endif
+
+/* rename entry points, they are only reachable through struct bch_spec */
+#define encode_bch            BCH_SPEC_NAME(encode_bch)
+#define decode_bch            BCH_SPEC_NAME(decode_bch)
+#define decode_bch_batch      BCH_SPEC_NAME(decode_bch_batch)
+
+#undef EXPORT_SYMBOL_GPL
+#define EXPORT_SYMBOL_GPL(_sym)
+
+#undef CONFIG_BCH_SPEC_LIST
+#undef CONFIG_BCH_ISA_LIST
+#undef CONFIG_BCH_CONST_TABLES
+#if !defined(BCH_SPEC_ISA)
+#define CONFIG_BCH_CONST_PARAMS
+#define CONFIG_BCH_CONST_M    BCH_SPEC_M
+#define CONFIG_BCH_CONST_T    BCH_SPEC_T
+#endif
+#define BCH_SPEC_VARIANT
+
+#include "bch.c"
+
+#if defined(BCH_SPEC_ISA)
+/* instruction set names, as understood by __builtin_cpu_supports() */
+#define BCH_ISA_x86_64_v2     "x86-64-v2"
+#define BCH_ISA_x86_64_v3     "x86-64-v3"
+#define BCH_ISA_x86_64_v4     "x86-64-v4"
+
+static int BCH_SPEC_NAME(supported)(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports(BCH_ISA_SYM(BCH_ISA, BCH_SPEC_ISA));
+}
+#endif
+
+const struct bch_spec BCH_SPEC_NAME(bch_spec) = {
+#if defined(BCH_SPEC_ISA)
+	.name         = BCH_STR(BCH_SPEC_ISA),
+	.supported    = BCH_SPEC_NAME(supported),
+#else
+	.name         = BCH_STR(BCH_SPEC_SYM(m, BCH_SPEC_M, BCH_SPEC_T)),
+	.m            = BCH_SPEC_M,
+	.t            = BCH_SPEC_T,
+#endif
+	.encode       = encode_bch,
+	.decode       = decode_bch,
+	.decode_batch = decode_bch_batch,
+};
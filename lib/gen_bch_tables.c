@@ -0,0 +1,95 @@
+/*
+ * Generate BCH lookup tables for CONFIG_BCH_CONST_TABLES builds
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright © 2011 Parrot S.A.
+ *
+ * Description:
+ *
+ * This host tool builds the lookup tables of a BCH code with init_bch(), and
+ * dumps them as const arrays to be included by lib/bch.c when both options
+ * CONFIG_BCH_CONST_PARAMS and CONFIG_BCH_CONST_TABLES are set:
+ *
+ * gen_bch_tables <m> <t> [prim_poly] > bch_const_tables.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bch.c"
+
+#define ENTRIES_PER_LINE 6
+
+static void output_table(const char *type, const char *name,
+			 const void *tab, unsigned int esize, unsigned int size)
+{
+	unsigned int i;
+	const uint16_t *tab16 = tab;
+	const uint32_t *tab32 = tab;
+
+	printf("static const %s bch_const_%s[%u] = {", type, name, size);
+	for (i = 0; i < size; i++) {
+		if ((i % ENTRIES_PER_LINE) == 0)
+			printf("\n\t");
+		else
+			printf(" ");
+		printf("0x%08x,", (esize == 2) ? tab16[i] : tab32[i]);
+	}
+	printf("\n};\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int m, t;
+	unsigned int prim_poly = 0;
+	struct bch_control *bch;
+
+	if ((argc < 3) || (argc > 4)) {
+		fprintf(stderr, "Usage: %s <m> <t> [prim_poly]\n", argv[0]);
+		return 1;
+	}
+	m = atoi(argv[1]);
+	t = atoi(argv[2]);
+	if (argc == 4)
+		prim_poly = strtoul(argv[3], NULL, 0);
+
+	bch = init_bch(m, t, prim_poly);
+	if (bch == NULL) {
+		fprintf(stderr, "cannot initialize BCH engine (m=%d, t=%d)\n",
+			m, t);
+		return 1;
+	}
+
+	printf("/* this file is generated by gen_bch_tables - do not edit */\n"
+	       "\n"
+	       "#define BCH_CONST_TABLES_M          %u\n"
+	       "#define BCH_CONST_TABLES_T          %u\n"
+	       "#define BCH_CONST_TABLES_PRIM_POLY  0x%x\n"
+	       "#define BCH_CONST_TABLES_ECC_BITS   %u\n"
+	       "\n", bch->m, bch->t, bch->gf->prim_poly, bch->ecc_bits);
+
+	/* entry size of Galois field tables is set by the including build */
+	output_table("bch_gf_t", "a_pow_tab", bch->a_pow_tab,
+		     sizeof(bch_gf_t), bch->n+1);
+	output_table("bch_gf_t", "a_log_tab", bch->a_log_tab,
+		     sizeof(bch_gf_t), bch->n+1);
+	output_table("uint32_t", "mod8_tab", bch->mod8_tab, 4,
+		     BCH_ECC_WORDS(bch)*1024);
+	output_table("unsigned int", "xi_tab", bch->xi_tab, 4, bch->m);
+
+	free_bch(bch);
+	return 0;
+}